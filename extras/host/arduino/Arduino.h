@@ -0,0 +1,107 @@
+/*
+ * Arduino.h - Host stand-in for the parts of the Arduino core qANSI uses
+ *
+ * PROGMEM data lives in normal memory, micros()/millis() come from the
+ * steady clock, and Serial is a stream that discards its output.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "Print.h"
+
+// --- Program memory ---
+#define PROGMEM
+typedef const char *PGM_P;
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define memcpy_P memcpy
+#define F(literal) (reinterpret_cast<const __FlashStringHelper *>(literal))
+
+// --- Math macros ---
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+// --- Time ---
+inline unsigned long micros() {
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline unsigned long millis() {
+  return micros() / 1000;
+}
+
+// --- Number conversion (avr-libc extensions) ---
+inline char *ultoa(unsigned long value, char *buffer, int base) {
+  char digits[8 * sizeof(value) + 1];
+  int i = 0;
+  do {
+    int d = value % base;
+    digits[i++] = d < 10 ? '0' + d : 'a' + d - 10;
+    value /= base;
+  } while (value);
+  char *p = buffer;
+  while (i) *p++ = digits[--i];
+  *p = 0;
+  return buffer;
+}
+
+inline char *ltoa(long value, char *buffer, int base) {
+  if (base == 10 && value < 0) {
+    buffer[0] = '-';
+    ultoa(0UL - (unsigned long)value, buffer + 1, base);
+    return buffer;
+  }
+  return ultoa((unsigned long)value, buffer, base);
+}
+
+inline char *itoa(int value, char *buffer, int base) {
+  return base == 10 ? ltoa(value, buffer, base) : ultoa((unsigned int)value, buffer, base);
+}
+
+inline char *utoa(unsigned int value, char *buffer, int base) {
+  return ultoa(value, buffer, base);
+}
+
+// --- String ---
+class String {
+public:
+  String(const char *str = "") : _str(str ? str : "") {}
+  const char *c_str() const { return _str.c_str(); }
+  unsigned int length() const { return _str.length(); }
+
+private:
+  std::string _str;
+};
+
+// --- Stream ---
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+};
+
+// Discards everything, like a Serial port nobody listens to
+class HostSerial : public Stream {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *, size_t size) override { return size; }
+  using Print::write;
+};
+
+static HostSerial Serial;
+
+#endif // Arduino_h
@@ -0,0 +1,92 @@
+/*
+ * Print.h - Host stand-in for the Arduino Print and Printable classes
+ *
+ * Just enough of the Arduino core to build qANSI on a desktop compiler
+ * for benchmarks and tests. Not a complete implementation.
+ */
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print;
+class __FlashStringHelper;
+
+class Printable {
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+  size_t write(const char *str) {
+    return str ? write((const uint8_t *)str, strlen(str)) : 0;
+  }
+  size_t write(const char *buffer, size_t size) {
+    return write((const uint8_t *)buffer, size);
+  }
+
+  // 0 means "unknown" like on most Arduino cores
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const char *str) { return write(str); }
+  size_t print(const __FlashStringHelper *str) { return write((const char *)str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = DEC) {
+    if (base == DEC) return _printf("%ld", n);
+    return print((unsigned long)n, base);
+  }
+  size_t print(unsigned long n, int base = DEC) {
+    if (base == HEX) return _printf("%lx", n);
+    if (base == OCT) return _printf("%lo", n);
+    if (base == BIN) {
+      char buf[8 * sizeof(n) + 1];
+      char *p = buf + sizeof(buf) - 1;
+      *p = 0;
+      do { *--p = '0' + (n & 1); n >>= 1; } while (n);
+      return write(p);
+    }
+    return _printf("%lu", n);
+  }
+  size_t print(double d, int digits = 2) { return _printf("%.*f", digits, d); }
+  size_t print(const Printable &p) { return p.printTo(*this); }
+
+  size_t println() { return write("\r\n"); }
+  template <class T> size_t println(const T &value) {
+    size_t n = print(value);
+    return n + println();
+  }
+  template <class T> size_t println(const T &value, int format) {
+    size_t n = print(value, format);
+    return n + println();
+  }
+
+private:
+  template <class... Args> size_t _printf(const char *format, Args... args) {
+    char buf[64];
+    int n = snprintf(buf, sizeof(buf), format, args...);
+    return n > 0 ? write((const uint8_t *)buf, (size_t)n) : 0;
+  }
+};
+
+#endif // Print_h
@@ -0,0 +1,831 @@
+/*
+ * bench.cpp - Micro-benchmarks for the qANSI and qANSI_VT hot paths
+ *
+ * Usage: bench [--corpus file] [filter]
+ *
+ * Every benchmark repeats its operation until it has run for at least
+ * 100 ms and reports the average time per operation. Rendering benchmarks
+ * also report the bytes sent per frame. Only benchmarks whose name
+ * contains the filter are run. Without --corpus the ANSI parser runs on
+ * a generated corpus (colored listings, progress bars, full-screen
+ * redraws, compiler diagnostics).
+ */
+
+// Standard headers first: Arduino.h defines min() and max() as macros
+#include <chrono>
+#include <string>
+
+#include <qANSI.h>
+#include <qANSI_VT.h>
+#include "HostStreams.h"
+
+static const char *filter = nullptr;
+static std::string corpus;
+
+// --- Timing ---
+
+struct Timing {
+  double ns;      // Total time
+  uint64_t ops;   // Operations run
+  double perOp() const { return ns / ops; }
+};
+
+template <class Op> static Timing measure(Op op) {
+  typedef std::chrono::steady_clock Clock;
+  Timing t = { 0, 0 };
+  uint64_t batch = 1;
+  while (t.ns < 100e6) {
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < batch; i++) op();
+    t.ns += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    t.ops += batch;
+    batch *= 2;
+  }
+  return t;
+}
+
+static bool selected(const char *name) {
+  return !filter || strstr(name, filter);
+}
+
+static void report(const char *name, const Timing &t, const char *unit = "ns/op") {
+  printf("%-44s %12.1f %s\n", name, t.perOp(), unit);
+}
+
+// Throughput of an operation that processes bytesPerOp bytes
+static void reportRate(const char *name, const Timing &t, size_t bytesPerOp) {
+  double mbps = (double)bytesPerOp * t.ops / (t.ns / 1e9) / 1e6;
+  printf("%-44s %12.1f ns/op %10.1f MB/s\n", name, t.perOp(), mbps);
+}
+
+// Time per frame and bytes sent per frame
+static void reportFrame(const char *name, const Timing &t, const CountingStream &out) {
+  printf("%-44s %12.1f ns/frame %8.1f bytes/frame\n", name, t.perOp(), (double)out.bytes / t.ops);
+}
+
+// --- Generated ANSI corpus ---
+
+static uint32_t rngState = 12345;
+
+static uint32_t rng(uint32_t range) {
+  rngState = rngState * 1103515245u + 12345u;
+  return (rngState >> 16) % range;
+}
+
+static void appendf(std::string &s, const char *format, int a = 0, int b = 0, int c = 0) {
+  char buf[128];
+  snprintf(buf, sizeof(buf), format, a, b, c);
+  s += buf;
+}
+
+static std::string generateCorpus(size_t size) {
+  static const char *names[] = { "src", "README.md", "build.sh", "main.cpp", "lib", "notes.txt" };
+  static const char *colors[] = { "01;34", "0", "01;32", "0", "01;34", "0" };
+  std::string s;
+  while (s.size() < size) {
+    switch (rng(5)) {
+      case 0: // ls --color
+        for (int i = 0; i < 6; i++) {
+          int n = rng(6);
+          s += "\033[";
+          s += colors[n];
+          s += "m";
+          s += names[n];
+          s += "\033[0m  ";
+        }
+        s += "\r\n";
+        break;
+      case 1: // Progress bar
+        for (int p = 0; p <= 100; p += 5) {
+          s += "\rDownloading [";
+          for (int i = 0; i < 20; i++) s += i < p / 5 ? '#' : ' ';
+          appendf(s, "] %3d%%\033[K", p);
+        }
+        s += "\r\n";
+        break;
+      case 2: // Full-screen redraw (top-like)
+        s += "\033]0;top - load average\007\033[H\033[2J\033[7m  PID USER      %CPU  COMMAND          \033[0m";
+        for (int row = 2; row <= 24; row++) {
+          appendf(s, "\033[%d;1H%5d root      ", row, 100 + rng(30000));
+          appendf(s, "\033[%dm%4d.%d\033[0m  ", rng(2) ? 31 : 32, rng(100), rng(10));
+          s += "worker\033[K";
+        }
+        break;
+      case 3: // Compiler diagnostic
+        appendf(s, "\033[01m\033[Kmain.cpp:%d:%d:\033[m\033[K \033[01;35m\033[Kwarning: \033[m\033[K", rng(500), rng(80));
+        s += "unused variable '\033[01m\033[Kbuf\033[m\033[K' [\033[01;35m\033[K-Wunused-variable\033[m\033[K]\r\n";
+        break;
+      case 4: // 256-color prompt
+        appendf(s, "\033[38;5;%dmuser\033[0m@\033[38;5;%dmhost\033[0m:\033[1;34m~/project\033[0m$ make\r\n",
+                rng(256), rng(256));
+        break;
+    }
+  }
+  return s;
+}
+
+// --- Write Throughput ---
+
+static const char plainLine[] = "The quick brown fox jumps over the lazy dog, 0123456789 times.";
+static const char pipeLine[] = "|04Alarm |15zone 3 |02armed |RA|11 12:45 |14battery |1093%|RA ok";
+static const char pipeCodes[] = "|04|15|02|RA|11|14|10|RA|B1|B0|U1|U0|16|17|00|07";
+
+static void benchWrite() {
+  CountingStream out;
+  qANSI direct(out);
+  direct.begin();
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+
+  if (selected("qANSI write() plain text")) {
+    reportRate("qANSI write() plain text", measure([&] { direct.print(plainLine); }), sizeof(plainLine) - 1);
+  }
+  if (selected("qANSI write() byte by byte")) {
+    reportRate("qANSI write() byte by byte", measure([&] {
+      for (const char *p = plainLine; *p; p++) direct.write((uint8_t)*p);
+    }), sizeof(plainLine) - 1);
+  }
+  if (selected("qANSI write() pipe-coded text")) {
+    reportRate("qANSI write() pipe-coded text", measure([&] { direct.print(pipeLine); }), sizeof(pipeLine) - 1);
+  }
+  if (selected("qANSI pipe-code decode")) {
+    Timing t = measure([&] { direct.print(pipeCodes); });
+    t.ops *= (sizeof(pipeCodes) - 1) / 3;
+    report("qANSI pipe-code decode", t, "ns/code");
+  }
+
+  if (selected("qANSI_VT write() plain text")) {
+    reportRate("qANSI_VT write() plain text", measure([&] {
+      vt.setCursor(1, 1);
+      vt.print(plainLine);
+    }), sizeof(plainLine) - 1);
+  }
+  if (selected("qANSI_VT write() byte by byte")) {
+    reportRate("qANSI_VT write() byte by byte", measure([&] {
+      vt.setCursor(1, 1);
+      for (const char *p = plainLine; *p; p++) vt.write((uint8_t)*p);
+    }), sizeof(plainLine) - 1);
+  }
+  if (selected("qANSI_VT writeSpan() plain text")) {
+    reportRate("qANSI_VT writeSpan() plain text", measure([&] {
+      vt.writeSpan(1, 1, plainLine, sizeof(plainLine) - 1);
+    }), sizeof(plainLine) - 1);
+  }
+
+  // Whole screens of text (no scrolling when the last cell is written)
+  qANSI_VT screen(80, 24, 1, 1, out);
+  screen.begin();
+  screen.setScrolling(false);
+  if (selected("qANSI_VT 80x24 screen: write() byte by byte")) {
+    reportRate("qANSI_VT 80x24 screen: write() byte by byte", measure([&] {
+      screen.setCursor(1, 1);
+      for (uint8_t y = 0; y < 24; y++) {
+        for (uint8_t x = 0; x < 80; x++) screen.write((uint8_t)('A' + (x + y) % 26));
+      }
+    }), 80 * 24);
+  }
+  if (selected("qANSI_VT 80x24 screen: writeSpan() per row")) {
+    char row[80];
+    for (uint8_t x = 0; x < 80; x++) row[x] = 'A' + x % 26;
+    reportRate("qANSI_VT 80x24 screen: writeSpan() per row", measure([&] {
+      for (uint8_t y = 1; y <= 24; y++) screen.writeSpan(1, y, row, sizeof(row));
+    }), 80 * 24);
+  }
+  if (selected("qANSI_VT write() pipe-coded text")) {
+    reportRate("qANSI_VT write() pipe-coded text", measure([&] {
+      vt.setCursor(1, 1);
+      vt.print(pipeLine);
+    }), sizeof(pipeLine) - 1);
+  }
+  if (selected("qANSI_VT pipe-code decode")) {
+    Timing t = measure([&] { vt.print(pipeCodes); });
+    t.ops *= (sizeof(pipeCodes) - 1) / 3;
+    report("qANSI_VT pipe-code decode", t, "ns/code");
+  }
+  if (selected("qANSI_VT ANSI parser corpus")) {
+    reportRate("qANSI_VT ANSI parser corpus", measure([&] {
+      vt.write((const uint8_t *)corpus.data(), corpus.size());
+    }), corpus.size());
+  }
+}
+
+// --- Sequence Formatting ---
+
+static void benchFormatting() {
+  CountingStream out;
+  qANSI direct(out);
+  direct.begin();
+  uint8_t n = 0;
+
+  if (selected("sprintf setCursor()")) {
+    report("sprintf setCursor()", measure([&] {
+      n++;
+      direct.setCursor(1 + n % 80, 1 + n % 24);
+    }));
+  }
+  if (selected("sprintf setTextColor()")) {
+    report("sprintf setTextColor()", measure([&] {
+      n++;
+      direct.setTextColor(30 + n % 8);
+    }));
+  }
+  if (selected("sprintf setTextColor(fg, bg)")) {
+    report("sprintf setTextColor(fg, bg)", measure([&] {
+      n++;
+      direct.setTextColor(30 + n % 8, 40 + n % 8);
+    }));
+  }
+  if (selected("compile-time send(seq<Cup, Fg>)")) {
+    static const qANSI_Sequence seq = qANSI::seq<qANSI_Seq::Cup<40, 12>, qANSI_Seq::Fg<31> >();
+    report("compile-time send(seq<Cup, Fg>)", measure([&] { direct.send(seq); }));
+  }
+}
+
+// --- Number Printing ---
+
+// The print() overloads qANSI_VT had before qANSI_Format, for comparison
+static size_t legacyPrint(qANSI_VT &vt, long n) {
+  char buf[8 * sizeof(long) + 1];
+  ltoa(n, buf, DEC);
+  return vt.print(buf);
+}
+
+static size_t legacyPrint(qANSI_VT &vt, double n, int digits) {
+  size_t count = 0;
+  if (n < 0.0) {
+    count += vt.print('-');
+    n = -n;
+  }
+  unsigned long intPart = (unsigned long)n;
+  double remainder = n - (double)intPart;
+  count += legacyPrint(vt, (long)intPart);
+  if (digits > 0) {
+    count += vt.print('.');
+    while (digits-- > 0) {
+      remainder *= 10.0;
+      int digit = (int)remainder;
+      count += legacyPrint(vt, (long)digit);
+      remainder -= digit;
+    }
+  }
+  return count;
+}
+
+static void benchNumbers() {
+  CountingStream out;
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  char buf[qANSI_Format::BUFFER_SIZE];
+  long value = 0;
+  double reading = 0;
+  const qANSI_NumberFormat field(8, 2);
+
+  // Formatting alone
+  if (selected("format long: snprintf")) {
+    report("format long: snprintf", measure([&] { snprintf(buf, sizeof(buf), "%ld", value += 7919); }));
+  }
+  if (selected("format long: ltoa")) {
+    report("format long: ltoa", measure([&] { ltoa(value += 7919, buf, DEC); }));
+  }
+  if (selected("format long: qANSI_Format")) {
+    report("format long: qANSI_Format", measure([&] {
+      qANSI_Format::formatSigned(buf, value += 7919, qANSI_NumberFormat());
+    }));
+  }
+  if (selected("format double: snprintf %.2f")) {
+    report("format double: snprintf %.2f", measure([&] { snprintf(buf, sizeof(buf), "%.2f", reading += 1.37); }));
+  }
+  if (selected("format double: qANSI_Format")) {
+    report("format double: qANSI_Format", measure([&] {
+      qANSI_Format::formatFloat(buf, reading += 1.37, qANSI_NumberFormat());
+    }));
+  }
+  if (selected("format double: qANSI_Format shortest")) {
+    const qANSI_NumberFormat shortest(0, 0, ' ', qANSI_NumberFormat::RIGHT, qANSI_NumberFormat::SHORTEST);
+    report("format double: qANSI_Format shortest", measure([&] {
+      qANSI_Format::formatFloat(buf, reading += 1.37, shortest);
+    }));
+  }
+
+  // Into the cell buffer
+  if (selected("VT print(long): ltoa + print(char*)")) {
+    report("VT print(long): ltoa + print(char*)", measure([&] {
+      vt.setCursor(1, 1);
+      legacyPrint(vt, value += 7919);
+    }));
+  }
+  if (selected("VT print(long)")) {
+    report("VT print(long)", measure([&] {
+      vt.setCursor(1, 1);
+      vt.print(value += 7919);
+    }));
+  }
+  if (selected("VT print(double): digit loop")) {
+    report("VT print(double): digit loop", measure([&] {
+      vt.setCursor(1, 1);
+      legacyPrint(vt, reading += 1.37, 2);
+    }));
+  }
+  if (selected("VT print(double)")) {
+    report("VT print(double)", measure([&] {
+      vt.setCursor(1, 1);
+      vt.print(reading += 1.37);
+    }));
+  }
+  if (selected("VT print(double, width 8)")) {
+    report("VT print(double, width 8)", measure([&] {
+      vt.setCursor(1, 1);
+      vt.print(reading += 1.37, field);
+    }));
+  }
+  if (selected("VT snprintf + print(char*)")) {
+    report("VT snprintf + print(char*)", measure([&] {
+      char line[64];
+      snprintf(line, sizeof(line), "%-8s %6.1f C %5ld rpm", "pump", reading += 1.37, value += 7919);
+      vt.setCursor(1, 1);
+      vt.print(line);
+    }));
+  }
+  if (selected("VT printAt(QANSI_FORMAT)")) {
+    report("VT printAt(QANSI_FORMAT)", measure([&] {
+      vt.printAt(1, 1, QANSI_FORMAT("%-8s %6.1f C %5ld rpm"), "pump", reading += 1.37, value += 7919);
+    }));
+  }
+  if (selected("VT 40 fields x print(long, width 8)")) {
+    report("VT 40 fields x print(long, width 8)", measure([&] {
+      for (uint8_t i = 0; i < 40; i++) {
+        vt.setCursor(1 + (i % 8) * 10, 1 + i / 8);
+        vt.print(value += 7919, qANSI_NumberFormat(8));
+      }
+    }));
+  }
+}
+
+// --- Scrolling ---
+
+static void benchScroll() {
+  CountingStream out;
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+
+  if (selected("scrollUp(1) 80x24")) {
+    report("scrollUp(1) 80x24", measure([&] { vt.scrollUp(1); }));
+  }
+  if (selected("scrollUp(1) 132x50")) {
+    qANSI_VT big(132, 50, 1, 1, out);
+    big.begin();
+    report("scrollUp(1) 132x50", measure([&] { big.scrollUp(1); }));
+  }
+}
+
+// --- display() per Strategy ---
+
+static void fillScreen(qANSI_VT &vt, char c) {
+  for (uint8_t y = 1; y <= vt.height(); y++) {
+    vt.setCursor(1, y);
+    for (uint8_t x = 1; x < vt.width(); x++) vt.write((uint8_t)c);
+  }
+}
+
+static void benchDisplay() {
+  CountingStream out;
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  fillScreen(vt, '.');
+  vt.display();
+
+  if (selected("display() full redraw")) {
+    out.reset();
+    Timing t = measure([&] {
+      vt.forceFullRedraw();
+      vt.display();
+    });
+    reportFrame("display() full redraw", t, out);
+  }
+  if (selected("display() sparse (3 cells)")) {
+    uint8_t n = 0;
+    out.reset();
+    Timing t = measure([&] {
+      for (int i = 0; i < 3; i++) {
+        n++;
+        vt.setCursor(1 + n % 79, 1 + (n * 7) % 24);
+        vt.write((uint8_t)('a' + n % 26));
+      }
+      vt.display();
+    });
+    reportFrame("display() sparse (3 cells)", t, out);
+  }
+  if (selected("display() rows (10 of 24 rows)")) {
+    uint8_t n = 0;
+    out.reset();
+    Timing t = measure([&] {
+      n++;
+      for (uint8_t y = 1; y <= 10; y++) {
+        vt.setCursor(1, y);
+        for (uint8_t x = 1; x < 80; x++) vt.write((uint8_t)('a' + (x + n) % 26));
+      }
+      vt.display();
+    });
+    reportFrame("display() rows (10 of 24 rows)", t, out);
+  }
+  if (selected("clear() 80x24")) {
+    report("clear() 80x24", measure([&] { vt.clear(false); }));
+  }
+  if (selected("forceFullRedraw() 80x24")) {
+    report("forceFullRedraw() 80x24", measure([&] { vt.forceFullRedraw(); }));
+  }
+  if (selected("page switch: clear() + 3 lines + display()")) {
+    uint8_t n = 0;
+    vt.display();
+    out.reset();
+    Timing t = measure([&] {
+      vt.clear(false);
+      for (uint8_t y = 1; y <= 3; y++) {
+        vt.setCursor(1, y);
+        vt.print("Page ");
+        vt.print(n++);
+      }
+      vt.display();
+    });
+    reportFrame("page switch: clear() + 3 lines + display()", t, out);
+  }
+  if (selected("display() nothing dirty")) {
+    vt.display();
+    out.reset();
+    Timing t = measure([&] { vt.display(); });
+    reportFrame("display() nothing dirty", t, out);
+  }
+}
+
+// --- Front Buffer ---
+
+// A large host console with and without a front buffer: a frame with no
+// changes, and the whole page printed again with three cells changed
+static void benchFrontBuffer(bool front) {
+  const char *idle = front ? "front buffer 250x100: display() nothing changed"
+                           : "dirty flags 250x100: display() nothing dirty";
+  const char *reprint = front ? "front buffer 250x100: page reprinted, 3 cells changed"
+                              : "dirty flags 250x100: page reprinted, 3 cells changed";
+  CountingStream out;
+  qANSI_VT vt(250, 100, 1, 1, out);
+  if (front) vt.enableFrontBuffer();
+  vt.begin();
+  vt.setScrolling(false);
+  fillScreen(vt, '.');
+  vt.display();
+
+  if (selected(idle)) {
+    out.reset();
+    Timing t = measure([&] { vt.display(); });
+    reportFrame(idle, t, out);
+  }
+  if (selected(reprint)) {
+    uint8_t n = 0;
+    out.reset();
+    Timing t = measure([&] {
+      fillScreen(vt, '.');
+      for (int i = 0; i < 3; i++) {
+        n++;
+        vt.setCursor(1 + n % 249, 1 + (n * 7) % 100);
+        vt.write((uint8_t)('a' + n % 26));
+      }
+      vt.display();
+    });
+    reportFrame(reprint, t, out);
+  }
+}
+
+// --- Rectangles ---
+
+// Eight bar gauges in a box, redrawn with the given run compression modes
+static void benchGauges(const char *name, uint8_t modes) {
+  if (!selected(name)) return;
+  CountingStream out;
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  vt.setRunCompression(modes);
+  vt.drawBox(1, 1, 80, 10);
+  vt.display();
+  uint32_t frame = 0;
+  out.reset();
+  Timing t = measure([&] {
+    frame++;
+    for (uint8_t bar = 0; bar < 8; bar++) {
+      uint8_t level = (frame * (bar + 3) * 7) % 78;
+      vt.fillRect(2, 2 + bar, level, 1, '#');
+      vt.clearRect(2 + level, 2 + bar, 78 - level, 1);
+    }
+    vt.display();
+  });
+  reportFrame(name, t, out);
+}
+
+static void benchRects() {
+  CountingStream out;
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  uint8_t n = 0;
+
+  if (selected("fill 78x22: setCursor + write()")) {
+    report("fill 78x22: setCursor + write()", measure([&] {
+      char c = 'a' + n++ % 26;
+      for (uint8_t y = 2; y <= 23; y++) {
+        vt.setCursor(2, y);
+        for (uint8_t x = 0; x < 78; x++) vt.write((uint8_t)c);
+      }
+    }));
+  }
+  if (selected("fill 78x22: fillRect()")) {
+    report("fill 78x22: fillRect()", measure([&] { vt.fillRect(2, 2, 78, 22, 'a' + n++ % 26); }));
+  }
+  if (selected("drawBox() 80x24")) {
+    report("drawBox() 80x24", measure([&] {
+      vt.drawBox(1, 1, 80, 24, n++ % 2 ? qANSI_Box::ASCII : qANSI_Box::DOUBLE);
+    }));
+  }
+  benchGauges("workload: bar gauges, no run compression", 0);
+  benchGauges("workload: bar gauges, ECH", qANSI_VT::RUN_ERASE);
+  benchGauges("workload: bar gauges, ECH + REP", qANSI_VT::RUN_ERASE | qANSI_VT::RUN_REPEAT);
+}
+
+// --- Blit and Sprites ---
+
+static void benchBlit() {
+  CountingStream out;
+  qANSI_VT vt(80, 24, 1, 1, out);
+  qANSI_VT first(40, 12, 1, 1, out), second(40, 12, 1, 1, out);
+  qANSI_VT *pages[2] = { &first, &second };
+  vt.begin();
+  for (uint8_t i = 0; i < 2; i++) {
+    pages[i]->begin();
+    fillScreen(*pages[i], 'a' + i);
+  }
+  uint8_t n = 0;
+
+  if (selected("copy 40x12: getCellAt() + write()")) {
+    report("copy 40x12: getCellAt() + write()", measure([&] {
+      const qANSI_VT &page = *pages[n++ % 2];
+      for (uint8_t y = 1; y <= 12; y++) {
+        vt.setCursor(21, 6 + y);
+        for (uint8_t x = 1; x <= 40; x++) {
+          AnsiCell cell = page.getCellAt(x, y);
+          vt.setTextColor(cell.fgColor, cell.bgColor);
+          vt.write((uint8_t)cell.character);
+        }
+      }
+    }));
+  }
+  if (selected("copy 40x12: blit()")) {
+    report("copy 40x12: blit()", measure([&] {
+      vt.blit(*pages[n++ % 2], qANSI_Rect(1, 1, 40, 12), 21, 7);
+    }));
+  }
+  if (selected("workload: popup sprite moving")) {
+    fillScreen(vt, '.');
+    vt.display();
+    AnsiCell image[20 * 6], saved[20 * 6];
+    for (uint8_t i = 0; i < 20 * 6; i++) {
+      AnsiCell cell = { '#', qANSI_Colors::FG_YELLOW, qANSI_Colors::BG_BLUE, 0, false };
+      image[i] = cell;
+    }
+    qANSI_Sprite sprite(image, 20, 6, saved);
+    out.reset();
+    Timing t = measure([&] {
+      n++;
+      vt.showSprite(sprite, 1 + n % 60, 1 + n % 18);
+      vt.display();
+    });
+    reportFrame("workload: popup sprite moving", t, out);
+  }
+}
+
+// --- Snapshots ---
+
+static void benchSnapshot() {
+  CountingStream out;
+  qANSI_VT vt(80, 24, 1, 1, out), copy(80, 24, 1, 1, out);
+  vt.begin();
+  copy.begin();
+  for (uint8_t y = 1; y <= 24; y++) {
+    vt.setCursor(1, y);
+    vt.setTextColor(31 + y % 7);
+    for (uint8_t x = 0; x < 8; x++) vt.print("log entry ");
+  }
+  vt.display();
+  static uint8_t snapshot[4096];
+  size_t size = vt.saveSnapshot(snapshot, sizeof(snapshot));
+
+  if (selected("snapshot 80x24: saveSnapshot()")) {
+    report("snapshot 80x24: saveSnapshot()", measure([&] { vt.saveSnapshot(snapshot, sizeof(snapshot)); }));
+  }
+  if (selected("snapshot 80x24: restoreSnapshot()")) {
+    report("snapshot 80x24: restoreSnapshot()", measure([&] { copy.restoreSnapshot(snapshot, size); }));
+  }
+  if (selected("reattach 80x24: full redraw")) {
+    out.reset();
+    Timing t = measure([&] {
+      vt.forceFullRedraw();
+      vt.display();
+    });
+    reportFrame("reattach 80x24: full redraw", t, out);
+  }
+  if (selected("reattach 80x24: paintSnapshot()")) {
+    out.reset();
+    Timing t = measure([&] { qANSI_VT::paintSnapshot(out, snapshot, size); });
+    reportFrame("reattach 80x24: paintSnapshot()", t, out);
+  }
+}
+
+// --- Workloads ---
+
+static void benchWorkloads() {
+  if (selected("workload: scrolling log")) {
+    CountingStream out;
+    qANSI_VT vt(80, 24, 1, 1, out);
+    vt.begin();
+    uint32_t line = 0;
+    out.reset();
+    Timing t = measure([&] {
+      vt.print("|08[");
+      vt.print(line++);
+      vt.print("] |07sensor |15update|07 value=");
+      vt.println(line * 7 % 1000);
+      vt.display();
+    });
+    reportFrame("workload: scrolling log", t, out);
+  }
+  if (selected("workload: counter dashboard")) {
+    CountingStream out;
+    qANSI_VT vt(80, 24, 1, 1, out);
+    vt.begin();
+    for (uint8_t i = 0; i < 10; i++) {
+      vt.setCursor(2, 2 + i * 2);
+      vt.print("|15Counter ");
+      vt.print(i);
+      vt.print(":|RA");
+    }
+    vt.display();
+    uint32_t tick = 0;
+    out.reset();
+    Timing t = measure([&] {
+      tick++;
+      for (uint8_t i = 0; i < 10; i++) {
+        vt.setCursor(16, 2 + i * 2);
+        vt.setTextColor(i % 2 ? qANSI_Colors::FG_GREEN : qANSI_Colors::FG_YELLOW);
+        vt.print((unsigned long)(tick * (i + 1)));
+      }
+      vt.display();
+    });
+    reportFrame("workload: counter dashboard", t, out);
+  }
+  if (selected("workload: dashboard on 2 streams, 2 VTs")) {
+    CountingStream out, mirror;
+    qANSI_VT vt(80, 24, 1, 1, out), copy(80, 24, 1, 1, mirror);
+    vt.begin();
+    copy.begin();
+    uint32_t tick = 0;
+    out.reset();
+    Timing t = measure([&] {
+      tick++;
+      for (uint8_t i = 0; i < 10; i++) {
+        vt.setCursor(16, 2 + i * 2);
+        vt.print((unsigned long)(tick * (i + 1)));
+        copy.setCursor(16, 2 + i * 2);
+        copy.print((unsigned long)(tick * (i + 1)));
+      }
+      vt.display();
+      copy.display();
+    });
+    reportFrame("workload: dashboard on 2 streams, 2 VTs", t, out);
+  }
+  if (selected("workload: dashboard on 2 streams, 1 VT + sink")) {
+    CountingStream out, mirror;
+    qANSI_VT vt(80, 24, 1, 1, out);
+    vt.begin();
+    vt.addSink(mirror);
+    uint32_t tick = 0;
+    out.reset();
+    Timing t = measure([&] {
+      tick++;
+      for (uint8_t i = 0; i < 10; i++) {
+        vt.setCursor(16, 2 + i * 2);
+        vt.print((unsigned long)(tick * (i + 1)));
+      }
+      vt.display();
+    });
+    reportFrame("workload: dashboard on 2 streams, 1 VT + sink", t, out);
+  }
+  if (selected("workload: bound-field dashboard")) {
+    CountingStream out;
+    qANSI_VT vt(80, 24, 1, 1, out);
+    vt.begin();
+    unsigned long values[10] = { 0 };
+    for (uint8_t i = 0; i < 10; i++) {
+      vt.setCursor(2, 2 + i * 2);
+      vt.print("|15Counter ");
+      vt.print(i);
+      vt.print(":|RA");
+      vt.bindField(16, 2 + i * 2, &values[i], qANSI_NumberFormat(10, 0, ' ', qANSI_NumberFormat::LEFT));
+    }
+    vt.refreshFields();
+    vt.display();
+    uint32_t tick = 0;
+    out.reset();
+    Timing t = measure([&] {
+      tick++;
+      for (uint8_t i = 0; i < 10; i++) values[i] = tick * (i + 1);
+      vt.refreshFields();
+      vt.display();
+    });
+    reportFrame("workload: bound-field dashboard", t, out);
+  }
+  if (selected("refreshFields() 40 fields, 1 changed")) {
+    CountingStream out;
+    qANSI_VT vt(80, 24, 1, 1, out);
+    vt.begin();
+    long values[40] = { 0 };
+    for (uint8_t i = 0; i < 40; i++) {
+      vt.bindField(1 + (i % 8) * 10, 1 + i / 8, &values[i], qANSI_NumberFormat(8));
+    }
+    vt.refreshFields();
+    uint32_t tick = 0;
+    report("refreshFields() 40 fields, 1 changed", measure([&] {
+      tick++;
+      values[tick % 40] = tick;
+      vt.refreshFields();
+    }));
+  }
+  if (selected("workload: full-screen animation")) {
+    CountingStream out;
+    qANSI_VT vt(80, 24, 1, 1, out);
+    vt.begin();
+    vt.setLineWrapping(false);
+    uint8_t phase = 0;
+    out.reset();
+    Timing t = measure([&] {
+      phase++;
+      for (uint8_t y = 1; y <= 24; y++) {
+        vt.setCursor(1, y);
+        for (uint8_t x = 1; x <= 80; x++) {
+          vt.setTextColor(31 + (x + y + phase) % 7);
+          vt.write((uint8_t)" .:-=+*#"[(x + phase) % 8]);
+        }
+      }
+      vt.display();
+    });
+    reportFrame("workload: full-screen animation", t, out);
+  }
+  if (selected("workload: sparse single-cell updates")) {
+    CountingStream out;
+    qANSI_VT vt(80, 24, 1, 1, out);
+    vt.begin();
+    fillScreen(vt, ' ');
+    vt.display();
+    uint16_t n = 0;
+    out.reset();
+    Timing t = measure([&] {
+      n++;
+      vt.setCursor(1 + (n * 13) % 79, 1 + (n * 5) % 24);
+      vt.write((uint8_t)('0' + n % 10));
+      vt.display();
+    });
+    reportFrame("workload: sparse single-cell updates", t, out);
+  }
+}
+
+static bool loadCorpus(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) corpus.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--corpus") && i + 1 < argc) {
+      if (!loadCorpus(argv[++i])) {
+        fprintf(stderr, "cannot read %s\n", argv[i]);
+        return 1;
+      }
+    } else {
+      filter = argv[i];
+    }
+  }
+  if (corpus.empty()) corpus = generateCorpus(1 << 20);
+
+  benchWrite();
+  benchFormatting();
+  benchNumbers();
+  benchScroll();
+  benchDisplay();
+  benchFrontBuffer(false);
+  benchFrontBuffer(true);
+  benchRects();
+  benchBlit();
+  benchSnapshot();
+  benchWorkloads();
+  return 0;
+}
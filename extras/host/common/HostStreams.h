@@ -0,0 +1,124 @@
+/*
+ * HostStreams.h - Output streams for the host benchmarks and tools
+ */
+
+#ifndef HOST_STREAMS_H
+#define HOST_STREAMS_H
+
+#include <Arduino.h>
+#include <string>
+
+// Counts bytes and escape sequences, discards the data
+class CountingStream : public Stream {
+public:
+  CountingStream() : bytes(0), escapes(0), room(0) {}
+
+  size_t write(uint8_t c) override {
+    bytes++;
+    if (c == 0x1B) escapes++;
+    return 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override {
+    bytes += size;
+    const uint8_t *end = buffer + size;
+    while ((buffer = (const uint8_t *)memchr(buffer, 0x1B, end - buffer)) != nullptr) {
+      escapes++;
+      buffer++;
+    }
+    return size;
+  }
+  using Print::write;
+
+  int availableForWrite() override { return room; }
+
+  void reset() {
+    bytes = 0;
+    escapes = 0;
+  }
+
+  uint64_t bytes;
+  uint64_t escapes;
+  int room;  // Reported by availableForWrite()
+};
+
+// Keeps everything that was written
+class CaptureStream : public Stream {
+public:
+  size_t write(uint8_t c) override {
+    data += (char)c;
+    return 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override {
+    data.append((const char *)buffer, size);
+    return size;
+  }
+  using Print::write;
+
+  std::string data;
+};
+
+// Stand-in for a slow link to the remote end of a state sync sink
+// (qANSI_VT::addSyncSink()). Holds the bytes of the frame in flight until
+// deliver() passes them on, or drop() loses them; pass frameSent as the
+// sync hook with the link as context.
+class LoopbackLink : public Stream {
+public:
+  LoopbackLink() : frame(0), inFlight(false), delivered(0) {}
+
+  size_t write(uint8_t c) override {
+    data += (char)c;
+    return 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override {
+    data.append((const char *)buffer, size);
+    return size;
+  }
+  using Print::write;
+
+  static void frameSent(uint8_t, uint16_t frame, void *context) {
+    LoopbackLink *link = (LoopbackLink *)context;
+    link->frame = frame;
+    link->inFlight = true;
+  }
+
+  // Write the frame in flight to the remote end, returns its number
+  uint16_t deliver(Print &remote) {
+    remote.write((const uint8_t *)data.data(), data.size());
+    delivered += data.size();
+    drop();
+    return frame;
+  }
+
+  void drop() {
+    data.clear();
+    inFlight = false;
+  }
+
+  std::string data;
+  uint16_t frame;       // Number of the frame in flight
+  bool inFlight;
+  uint64_t delivered;   // Bytes passed on by deliver()
+};
+
+// Writes to a stdio file
+class HostPrint : public Print {
+public:
+  explicit HostPrint(FILE *file) : _file(file) {}
+
+  size_t write(uint8_t c) override {
+    return fputc(c, _file) == EOF ? 0 : 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override {
+    return fwrite(buffer, 1, size, _file);
+  }
+  using Print::write;
+
+private:
+  FILE *_file;
+};
+
+#endif // HOST_STREAMS_H
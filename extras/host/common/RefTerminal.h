@@ -0,0 +1,389 @@
+/*
+ * RefTerminal.h - Reference terminal model for checking qANSI output
+ *
+ * A Stream that interprets what it receives like an xterm-compatible
+ * terminal: cursor movement with pending autowrap, SGR colors and
+ * attributes, erase and insert/delete, repeat (REP), scroll regions
+ * (DECSTBM), save/restore cursor and the ?7/?25 modes. Written independently of the
+ * parser in qANSI_VT.h, so the two can be checked against each other.
+ */
+
+#ifndef REF_TERMINAL_H
+#define REF_TERMINAL_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+class RefTerminal : public Stream {
+public:
+  // Attribute bits of a cell
+  enum {
+    BOLD = 0x01, FAINT = 0x02, ITALIC = 0x04, UNDERLINE = 0x08,
+    BLINK = 0x10, REVERSE = 0x20, CONCEALED = 0x40, CROSSED = 0x80
+  };
+
+  struct Cell {
+    char ch;
+    uint8_t fg;     // SGR code, 39 = default
+    uint8_t bg;     // SGR code, 49 = default
+    uint8_t attrs;
+  };
+
+  RefTerminal(int width = 80, int height = 24) : _width(width), _height(height), _bce(true) {
+    reset();
+  }
+
+  // Background color erase: erased cells take the current background
+  // (xterm), or the default one (terminals without bce)
+  void setBackgroundColorErase(bool bce) { _bce = bce; }
+
+  // Power-on state (RIS)
+  void reset() {
+    Cell blank = { ' ', 39, 49, 0 };
+    _cells.assign(_width * _height, blank);
+    _x = _y = 1;
+    _pendingWrap = false;
+    _lastChar = -1;
+    _fg = 39;
+    _bg = 49;
+    _attrs = 0;
+    _top = 1;
+    _bottom = _height;
+    _autowrap = true;
+    _cursorVisible = true;
+    _savedX = _savedY = 1;
+    _savedFg = 39;
+    _savedBg = 49;
+    _savedAttrs = 0;
+    _state = GROUND;
+  }
+
+  const Cell &cell(int x, int y) const { return _cells[(y - 1) * _width + (x - 1)]; }
+  int width() const { return _width; }
+  int height() const { return _height; }
+  int cursorX() const { return _x; }
+  int cursorY() const { return _y; }
+  bool cursorVisible() const { return _cursorVisible; }
+
+  // Screen rows as text, for failure reports
+  std::string row(int y, int x1 = 1, int x2 = 0) const {
+    if (x2 == 0) x2 = _width;
+    std::string s;
+    for (int x = x1; x <= x2; x++) s += cell(x, y).ch;
+    return s;
+  }
+
+  // --- Stream ---
+  size_t write(uint8_t c) override {
+    _input(c);
+    return 1;
+  }
+  using Print::write;
+
+private:
+  enum { GROUND, ESCAPE, CSI, STRING, STRING_ESC };
+
+  int _width, _height;
+  std::vector<Cell> _cells;
+  int _x, _y;              // Cursor, 1-based
+  bool _pendingWrap;       // Last column written, wrap on the next character
+  int _lastChar;           // Character REP repeats, -1 after anything but text
+  uint8_t _fg, _bg, _attrs;
+  int _top, _bottom;       // Scroll region
+  bool _autowrap, _cursorVisible;
+  bool _bce;
+  int _savedX, _savedY;
+  uint8_t _savedFg, _savedBg, _savedAttrs;
+
+  int _state;
+  std::string _params;     // Parameter and intermediate bytes of a CSI
+  char _private;
+
+  Cell &_at(int x, int y) { return _cells[(y - 1) * _width + (x - 1)]; }
+
+  Cell _blank() const {
+    Cell c = { ' ', _fg, (uint8_t)(_bce ? _bg : 49), 0 };  // Erased cells take the current colors
+    return c;
+  }
+
+  void _input(uint8_t c) {
+    switch (_state) {
+      case GROUND:
+        if (c == 0x1B) {
+          _state = ESCAPE;
+        } else if (c < 0x20 || c == 0x7F) {
+          _lastChar = -1;
+          _control(c);
+        } else {
+          _print(c);
+          _lastChar = c;
+        }
+        break;
+      case ESCAPE:
+        if (c == '[') {
+          _state = CSI;
+          _params.clear();
+          _private = 0;
+        } else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') {
+          _state = STRING;
+        } else {
+          _state = GROUND;
+          _escape(c);
+        }
+        break;
+      case CSI:
+        if (c >= 0x40 && c <= 0x7E) {
+          _state = GROUND;
+          _csi(c);
+        } else if (c >= 0x3C && c <= 0x3F && _params.empty()) {
+          _private = c;
+        } else if (c == 0x1B) {
+          _state = ESCAPE;
+        } else if (c < 0x20) {
+          _control(c);
+        } else {
+          _params += (char)c;
+        }
+        break;
+      case STRING:
+        if (c == 0x07) _state = GROUND;
+        else if (c == 0x1B) _state = STRING_ESC;
+        break;
+      case STRING_ESC:
+        _state = c == '\\' ? GROUND : STRING;
+        break;
+    }
+  }
+
+  void _control(uint8_t c) {
+    switch (c) {
+      case '\r': _x = 1; _pendingWrap = false; break;
+      case '\n': case 0x0B: case 0x0C: _lineFeed(); break;
+      case '\b': if (_x > 1) _x--; _pendingWrap = false; break;
+      case '\t':
+        _x = ((_x - 1) / 8 + 1) * 8 + 1;
+        if (_x > _width) _x = _width;
+        break;
+    }
+  }
+
+  void _print(uint8_t c) {
+    if (_pendingWrap && _autowrap) {
+      _x = 1;
+      _lineFeed();
+    }
+    _pendingWrap = false;
+    Cell &cell = _at(_x, _y);
+    cell.ch = (char)c;
+    cell.fg = _fg;
+    cell.bg = _bg;
+    cell.attrs = _attrs;
+    if (_x < _width) {
+      _x++;
+    } else {
+      _pendingWrap = true;
+    }
+  }
+
+  void _lineFeed() {
+    _pendingWrap = false;
+    if (_y == _bottom) {
+      _scrollUp(1);
+    } else if (_y < _height) {
+      _y++;
+    }
+  }
+
+  void _reverseIndex() {
+    _pendingWrap = false;
+    if (_y == _top) {
+      _scrollDown(1);
+    } else if (_y > 1) {
+      _y--;
+    }
+  }
+
+  void _scrollUp(int n) {
+    for (int y = _top; y <= _bottom; y++) {
+      for (int x = 1; x <= _width; x++) {
+        _at(x, y) = y + n <= _bottom ? _at(x, y + n) : _blank();
+      }
+    }
+  }
+
+  void _scrollDown(int n) {
+    for (int y = _bottom; y >= _top; y--) {
+      for (int x = 1; x <= _width; x++) {
+        _at(x, y) = y - n >= _top ? _at(x, y - n) : _blank();
+      }
+    }
+  }
+
+  void _erase(int x1, int y1, int x2, int y2) {
+    for (int y = y1; y <= y2; y++) {
+      for (int x = (y == y1 ? x1 : 1); x <= (y == y2 ? x2 : _width); x++) {
+        _at(x, y) = _blank();
+      }
+    }
+  }
+
+  void _escape(uint8_t c) {
+    _lastChar = -1;
+    switch (c) {
+      case '7':
+        _savedX = _x; _savedY = _y;
+        _savedFg = _fg; _savedBg = _bg; _savedAttrs = _attrs;
+        break;
+      case '8':
+        _x = _savedX; _y = _savedY;
+        _fg = _savedFg; _bg = _savedBg; _attrs = _savedAttrs;
+        _pendingWrap = false;
+        break;
+      case 'D': _lineFeed(); break;
+      case 'E': _x = 1; _lineFeed(); break;
+      case 'M': _reverseIndex(); break;
+      case 'c': reset(); break;
+    }
+  }
+
+  std::vector<int> _parseParams() const {
+    std::vector<int> params;
+    int value = -1;
+    for (size_t i = 0; i < _params.size(); i++) {
+      char c = _params[i];
+      if (c >= '0' && c <= '9') {
+        value = (value < 0 ? 0 : value) * 10 + (c - '0');
+      } else if (c == ';' || c == ':') {
+        params.push_back(value);
+        value = -1;
+      }
+    }
+    if (value >= 0 || !params.empty()) params.push_back(value);
+    return params;
+  }
+
+  static int _param(const std::vector<int> &p, size_t i, int def) {
+    return i < p.size() && p[i] > 0 ? p[i] : def;
+  }
+
+  static int _clamp(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+  void _csi(uint8_t final) {
+    std::vector<int> p = _parseParams();
+    int n = _param(p, 0, 1);
+    if (_private == '?') {
+      for (size_t i = 0; i < p.size(); i++) {
+        if (p[i] == 25 && (final == 'h' || final == 'l')) _cursorVisible = final == 'h';
+        if (p[i] == 7 && (final == 'h' || final == 'l')) _autowrap = final == 'h';
+      }
+      return;
+    }
+    if (_private) return;
+    if (final == 'b') {
+      // REP must follow a printed character (or another REP) directly
+      for (int i = 0; _lastChar >= 0 && i < n; i++) _print((uint8_t)_lastChar);
+      return;
+    }
+    _lastChar = -1;
+    if (final != 'm') _pendingWrap = false;
+
+    switch (final) {
+      case 'm': _sgr(p); break;
+      case 'H': case 'f':
+        _y = _clamp(n, 1, _height);
+        _x = _clamp(_param(p, 1, 1), 1, _width);
+        break;
+      case 'A': _y = _clamp(_y - n, _y >= _top ? _top : 1, _height); break;
+      case 'B': _y = _clamp(_y + n, 1, _y <= _bottom ? _bottom : _height); break;
+      case 'C': _x = _clamp(_x + n, 1, _width); break;
+      case 'D': _x = _clamp(_x - n, 1, _width); break;
+      case 'E': _y = _clamp(_y + n, 1, _height); _x = 1; break;
+      case 'F': _y = _clamp(_y - n, 1, _height); _x = 1; break;
+      case 'G': _x = _clamp(n, 1, _width); break;
+      case 'd': _y = _clamp(n, 1, _height); break;
+      case 'J':
+        switch (_param(p, 0, 0)) {
+          case 0: _erase(_x, _y, _width, _height); break;
+          case 1: _erase(1, 1, _x, _y); break;
+          default: _erase(1, 1, _width, _height); break;
+        }
+        break;
+      case 'K':
+        switch (_param(p, 0, 0)) {
+          case 0: _erase(_x, _y, _width, _y); break;
+          case 1: _erase(1, _y, _x, _y); break;
+          default: _erase(1, _y, _width, _y); break;
+        }
+        break;
+      case 'X': _erase(_x, _y, _clamp(_x + n - 1, 1, _width), _y); break;
+      case '@':
+        for (int x = _width; x >= _x; x--) _at(x, _y) = x - n >= _x ? _at(x - n, _y) : _blank();
+        break;
+      case 'P':
+        for (int x = _x; x <= _width; x++) _at(x, _y) = x + n <= _width ? _at(x + n, _y) : _blank();
+        break;
+      case 'L': case 'M':
+        if (_y >= _top && _y <= _bottom) {
+          int top = _top;
+          _top = _y;
+          if (final == 'L') _scrollDown(n); else _scrollUp(n);
+          _top = top;
+          _x = 1;
+        }
+        break;
+      case 'S': _scrollUp(n); break;
+      case 'T': _scrollDown(n); break;
+      case 'r': {
+        int top = _param(p, 0, 1), bottom = _param(p, 1, _height);
+        if (top < bottom && bottom <= _height) {
+          _top = top;
+          _bottom = bottom;
+          _x = _y = 1;
+        }
+        break;
+      }
+      case 's': _savedX = _x; _savedY = _y; break;
+      case 'u': _x = _savedX; _y = _savedY; break;
+    }
+  }
+
+  void _sgr(const std::vector<int> &p) {
+    if (p.empty()) {
+      _fg = 39; _bg = 49; _attrs = 0;
+      return;
+    }
+    for (size_t i = 0; i < p.size(); i++) {
+      int c = p[i] < 0 ? 0 : p[i];
+      switch (c) {
+        case 0: _fg = 39; _bg = 49; _attrs = 0; break;
+        case 1: _attrs |= BOLD; break;
+        case 2: _attrs |= FAINT; break;
+        case 3: _attrs |= ITALIC; break;
+        case 4: _attrs |= UNDERLINE; break;
+        case 5: case 6: _attrs |= BLINK; break;
+        case 7: _attrs |= REVERSE; break;
+        case 8: _attrs |= CONCEALED; break;
+        case 9: _attrs |= CROSSED; break;
+        case 22: _attrs &= ~(BOLD | FAINT); break;
+        case 23: _attrs &= ~ITALIC; break;
+        case 24: _attrs &= ~UNDERLINE; break;
+        case 25: _attrs &= ~BLINK; break;
+        case 27: _attrs &= ~REVERSE; break;
+        case 28: _attrs &= ~CONCEALED; break;
+        case 29: _attrs &= ~CROSSED; break;
+        case 38: case 48: {
+          int mode = i + 1 < p.size() ? p[i + 1] : 0;
+          i += mode == 5 ? 2 : mode == 2 ? 4 : 1;
+          break;
+        }
+        default:
+          if ((c >= 30 && c <= 37) || c == 39 || (c >= 90 && c <= 97)) _fg = c;
+          if ((c >= 40 && c <= 47) || c == 49 || (c >= 100 && c <= 107)) _bg = c;
+          break;
+      }
+    }
+  }
+};
+
+#endif // REF_TERMINAL_H
@@ -0,0 +1,579 @@
+/*
+ * fuzz.cpp - Differential fuzzer for qANSI_VT output
+ *
+ * Usage: fuzz [--cases N] [--ops N] [--seed S]
+ *
+ * Each case drives a qANSI_VT with random operations (text with pipe
+ * codes and escape sequences, setCursor, scrollUp, clear, setPosition,
+ * forceFullRedraw, colors, rectangles and boxes, blits, a sprite, run
+ * compression modes, budget-limited and full display() calls) while
+ * its output goes into the RefTerminal model. After every completed
+ * frame the modeled screen must match the VT buffer cell for cell. A
+ * second model is attached as a sink (possibly late, with its own budget
+ * and run compression modes) and must match whenever it has caught up. A
+ * third one sits behind a state sync sink whose frames are delivered,
+ * held back or lost at random, and must match once it has acknowledged
+ * the current contents. Snapshots are painted on a fresh model and
+ * restored into a second terminal, both must match the buffer. QANSI_PIPE
+ * literals must store the same cells as the codes parsed at runtime.
+ *
+ * On a mismatch the operation sequence is shrunk to a minimal one that
+ * still fails, and printed as code. The bytes display() sent are compared
+ * with a baseline that does a full redraw for every frame.
+ */
+
+// Standard headers first: Arduino.h defines min() and max() as macros
+#include <random>
+#include <string>
+#include <vector>
+
+#include <qANSI.h>
+#include <qANSI_VT.h>
+#include "HostStreams.h"
+#include "RefTerminal.h"
+
+static const int SCREEN_WIDTH = 80;
+static const int SCREEN_HEIGHT = 24;
+
+// --- Operations ---
+
+enum LinkAction { LINK_DELIVER, LINK_HOLD, LINK_DROP };
+
+enum OpKind {
+  OP_WRITE, OP_SET_CURSOR, OP_SCROLL_UP, OP_CLEAR, OP_SET_POSITION,
+  OP_FORCE_REDRAW, OP_SET_COLOR, OP_SET_BACKGROUND, OP_SET_ATTRIBUTE,
+  OP_SET_WRAPPING, OP_SET_CURSOR_VISIBLE, OP_DISPLAY, OP_DISPLAY_BUDGET,
+  OP_FILL_RECT, OP_DRAW_BOX, OP_SET_RUN_COMPRESSION, OP_BLIT, OP_SHOW_SPRITE,
+  OP_HIDE_SPRITE, OP_SNAPSHOT, OP_FRONT_BUFFER, OP_SET_SCROLLING, OP_DEFINE_CODE,
+  OP_PIPE_LITERAL, OP_COUNT
+};
+
+struct Op {
+  int kind;
+  int a, b, w, h, x, y;
+  int link;           // LinkAction for the state sync frame after a display
+  std::string text;
+};
+
+struct Case {
+  int width, height, posX, posY;
+  int sinkAt, sinkModes, sinkBudget;   // Mirror sink added before operation sinkAt
+  int syncAt, syncModes, syncBudget;   // State sync sink added before operation syncAt
+  std::vector<Op> ops;
+};
+
+static std::string quote(const std::string &s) {
+  std::string q = "\"";
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = s[i];
+    char buf[8];
+    if (c == '\n') q += "\\n";
+    else if (c == '\r') q += "\\r";
+    else if (c == '"' || c == '\\') { q += '\\'; q += c; }
+    else if (c < 0x20 || c >= 0x7F) { snprintf(buf, sizeof(buf), "\\x%02x\"\"", c); q += buf; }
+    else q += c;
+  }
+  return q + "\"";
+}
+
+// QANSI_PIPE literals, with their source for the runtime parser
+static const char *const pipeLiteralSource[] = {
+  "|04Red |02Green|RA", "|14|B1Hi|RA there\n", "|17|15x|U1long underlined text|U0|RA",
+  "plain", "|12", "a\tb|R1c|R0"
+};
+static const int PIPE_LITERAL_COUNT = sizeof(pipeLiteralSource) / sizeof(pipeLiteralSource[0]);
+
+static qANSI_PipeText pipeLiteral(int i) {
+  switch (i) {
+    case 0: return QANSI_PIPE("|04Red |02Green|RA");
+    case 1: return QANSI_PIPE("|14|B1Hi|RA there\n");
+    case 2: return QANSI_PIPE("|17|15x|U1long underlined text|U0|RA");
+    case 3: return QANSI_PIPE("plain");
+    case 4: return QANSI_PIPE("|12");
+    default: return QANSI_PIPE("a\tb|R1c|R0");
+  }
+}
+
+static std::string describe(const Op &op) {
+  char buf[64];
+  switch (op.kind) {
+    case OP_WRITE: return "vt.print(" + quote(op.text) + ");";
+    case OP_SET_CURSOR: snprintf(buf, sizeof(buf), "vt.setCursor(%d, %d);", op.a, op.b); break;
+    case OP_SCROLL_UP: snprintf(buf, sizeof(buf), "vt.scrollUp(%d);", op.a); break;
+    case OP_CLEAR: snprintf(buf, sizeof(buf), "vt.clear(%s);", op.a ? "true" : "false"); break;
+    case OP_SET_POSITION: snprintf(buf, sizeof(buf), "vt.setPosition(%d, %d);", op.a, op.b); break;
+    case OP_FORCE_REDRAW: return "vt.forceFullRedraw();";
+    case OP_SET_COLOR: snprintf(buf, sizeof(buf), "vt.setTextColor(%d);", op.a); break;
+    case OP_SET_BACKGROUND: snprintf(buf, sizeof(buf), "vt.setTextBackgroundColor(%d);", op.a); break;
+    case OP_SET_ATTRIBUTE: snprintf(buf, sizeof(buf), "vt.setTextAttribute(%d);", op.a); break;
+    case OP_SET_WRAPPING: snprintf(buf, sizeof(buf), "vt.setLineWrapping(%s);", op.a ? "true" : "false"); break;
+    case OP_SET_CURSOR_VISIBLE: snprintf(buf, sizeof(buf), "vt.setCursorVisible(%s);", op.a ? "true" : "false"); break;
+    case OP_DISPLAY:
+    case OP_DISPLAY_BUDGET: {
+      static const char *const links[] = { "deliver", "hold", "drop" };
+      char call[32] = "vt.display();";
+      if (op.kind == OP_DISPLAY_BUDGET) snprintf(call, sizeof(call), "vt.display(qANSI_Budget(%d));", op.a);
+      snprintf(buf, sizeof(buf), "%-32s// link: %s", call, links[op.link]);
+      break;
+    }
+    case OP_FILL_RECT:
+      snprintf(buf, sizeof(buf), "vt.fillRect(%d, %d, %d, %d, '%c');", op.a, op.b, op.w, op.h, op.text[0]);
+      break;
+    case OP_DRAW_BOX: snprintf(buf, sizeof(buf), "vt.drawBox(%d, %d, %d, %d);", op.a, op.b, op.w, op.h); break;
+    case OP_SET_RUN_COMPRESSION: snprintf(buf, sizeof(buf), "vt.setRunCompression(%d);", op.a); break;
+    case OP_BLIT:
+      snprintf(buf, sizeof(buf), "vt.blit(vt, qANSI_Rect(%d, %d, %d, %d), %d, %d);", op.a, op.b, op.w, op.h,
+               op.x, op.y);
+      break;
+    case OP_SHOW_SPRITE: snprintf(buf, sizeof(buf), "vt.showSprite(sprite, %d, %d);", op.a, op.b); break;
+    case OP_HIDE_SPRITE: return "vt.hideSprite(sprite);";
+    case OP_SNAPSHOT: snprintf(buf, sizeof(buf), "// snapshot, painted with modes %d", op.a); break;
+    case OP_FRONT_BUFFER: snprintf(buf, sizeof(buf), "vt.enableFrontBuffer(%s);", op.a ? "true" : "false"); break;
+    case OP_SET_SCROLLING: snprintf(buf, sizeof(buf), "vt.setScrolling(%s);", op.a ? "true" : "false"); break;
+    case OP_DEFINE_CODE:
+      snprintf(buf, sizeof(buf), "for (int i = 0; i < %d; i++) table.define(\"HI\", ", op.a);
+      return buf + quote(op.text) + ");";
+    case OP_PIPE_LITERAL: return "vt.print(QANSI_PIPE(" + quote(pipeLiteralSource[op.a]) + "));";
+    default: return "?";
+  }
+  return buf;
+}
+
+// --- Random Cases ---
+
+static std::mt19937 rng;
+
+static int random(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+static std::string randomText() {
+  static const char *const pieces[] = {
+    "|04", "|15", "|RA", "|B1", "|U1", "|17", "|99", "|HI", "|LO", "\n", "\r", "\b", "\t",
+    "\033[1m", "\033[0m", "\033[31;44m", "\033[58;5;1m", "\033[38:2::1:4:5;7m", "\033[2;3H", "\033[K", "\033[1J", "\033[2P", "\033[3@",
+    "\033[L", "\033[M", "\033[S", "\033[T", "\033[4C", "\0337", "\0338", "\033M"
+  };
+  std::string text;
+  int n = random(1, 12);
+  for (int i = 0; i < n; i++) {
+    if (random(0, 3) == 0) {
+      text += pieces[random(0, sizeof(pieces) / sizeof(pieces[0]) - 1)];
+    } else {
+      int run = random(1, 8);
+      for (int j = 0; j < run; j++) text += (char)random('!', '~');
+    }
+  }
+  return text;
+}
+
+// Expansion for the custom code "HI": built-in codes, "LO" and text
+static std::string randomExpansion() {
+  static const char *const pieces[] = { "|04", "|15", "|RA", "|B1", "|U1", "|LO", "ok", "x" };
+  std::string text;
+  int n = random(0, 4);
+  for (int i = 0; i < n; i++) text += pieces[random(0, sizeof(pieces) / sizeof(pieces[0]) - 1)];
+  return text;
+}
+
+// Redefine "HI" times times and check that it expands like the same
+// definition in a fresh table (a redefinition reuses the pool space of the
+// old one)
+static bool checkDefine(qANSI_PipeTable &table, const std::string &expansion, int times,
+                        std::string &failure) {
+  qANSI_PipeTable fresh;
+  fresh.define("LO", "|12|17");
+  for (int i = 0; i < times; i++) {
+    if (!table.define("HI", expansion.c_str())) {
+      failure = "pipe table: redefinition failed\n";
+      return false;
+    }
+  }
+  if (!fresh.define("HI", expansion.c_str())) {
+    failure = "pipe table: define() failed\n";
+    return false;
+  }
+  CaptureStream code, expanded;
+  qANSI viaTable(code), viaFresh(expanded);
+  viaTable.setPipeTable(&table);
+  viaFresh.setPipeTable(&fresh);
+  viaTable.print("|HI|LO");
+  viaFresh.print("|HI|LO");
+  if (code.data != expanded.data) {
+    failure = "pipe table: |HI does not expand like its definition\n";
+    return false;
+  }
+  return true;
+}
+
+static Op randomOp(const Case &c) {
+  static const int attributes[] = { 0, 1, 4, 5, 7, 8, 22, 24 };
+  Op op;
+  op.kind = random(0, OP_COUNT - 1);
+  op.a = op.b = op.w = op.h = op.x = op.y = 0;
+  op.link = random(0, 3) == 0 ? random(LINK_HOLD, LINK_DROP) : LINK_DELIVER;
+  switch (op.kind) {
+    case OP_WRITE: op.text = randomText(); break;
+    case OP_SET_CURSOR: op.a = random(1, c.width + 2); op.b = random(1, c.height + 1); break;
+    case OP_SCROLL_UP: op.a = random(1, 3); break;
+    case OP_CLEAR: op.a = random(0, 1); break;
+    case OP_SET_POSITION:
+      op.a = random(1, SCREEN_WIDTH - c.width + 1);
+      op.b = random(1, SCREEN_HEIGHT - c.height + 1);
+      break;
+    case OP_SET_COLOR: op.a = random(0, 1) ? random(30, 37) : random(0, 1) ? 39 : random(90, 97); break;
+    case OP_SET_BACKGROUND: op.a = random(0, 1) ? random(40, 47) : 49; break;
+    case OP_SET_ATTRIBUTE: op.a = attributes[random(0, 7)]; break;
+    case OP_SET_WRAPPING: op.a = random(0, 3) != 0; break;
+    case OP_SET_CURSOR_VISIBLE: op.a = random(0, 1); break;
+    case OP_DISPLAY_BUDGET: op.a = random(8, 120); break;
+    case OP_FILL_RECT:
+    case OP_DRAW_BOX:
+      op.a = random(1, c.width + 1);
+      op.b = random(1, c.height + 1);
+      op.w = random(0, c.width + 2);
+      op.h = random(0, c.height + 2);
+      op.text = std::string(1, random(0, 1) ? ' ' : (char)random('!', '~'));
+      break;
+    case OP_SET_RUN_COMPRESSION: op.a = random(0, 3); break;
+    case OP_BLIT:
+      op.a = random(1, c.width);
+      op.b = random(1, c.height);
+      op.w = random(0, c.width);
+      op.h = random(0, c.height);
+      op.x = random(1, c.width + 1);
+      op.y = random(1, c.height + 1);
+      break;
+    case OP_SHOW_SPRITE: op.a = random(1, c.width + 1); op.b = random(1, c.height + 1); break;
+    case OP_SNAPSHOT: op.a = random(0, 3); break;
+    case OP_FRONT_BUFFER: op.a = random(0, 1); break;
+    case OP_SET_SCROLLING: op.a = random(0, 3) != 0; break;
+    case OP_DEFINE_CODE: op.text = randomExpansion(); op.a = random(1, 40); break;
+    case OP_PIPE_LITERAL: op.a = random(0, PIPE_LITERAL_COUNT - 1); break;
+  }
+  return op;
+}
+
+static Case randomCase(int opCount) {
+  Case c;
+  c.width = random(1, 30);
+  c.height = random(1, 10);
+  c.posX = random(1, SCREEN_WIDTH - c.width + 1);
+  c.posY = random(1, SCREEN_HEIGHT - c.height + 1);
+  c.sinkAt = random(0, 1) ? 0 : random(0, opCount);
+  c.sinkModes = random(0, 3);
+  c.sinkBudget = random(0, 1) ? 0 : random(20, 200);
+  c.syncAt = random(0, opCount);
+  c.syncModes = random(0, 3);
+  c.syncBudget = random(0, 1) ? 0 : random(20, 200);
+  for (int i = 0; i < opCount; i++) c.ops.push_back(randomOp(c));
+  return c;
+}
+
+// --- Running a Case ---
+
+// Expected terminal attribute bits for a cell attribute
+static uint8_t attributeBits(uint8_t attr) {
+  switch (attr) {
+    case 1: return RefTerminal::BOLD;
+    case 4: return RefTerminal::UNDERLINE;
+    case 5: return RefTerminal::BLINK;
+    case 7: return RefTerminal::REVERSE;
+    case 8: return RefTerminal::CONCEALED;
+    default: return 0;  // RESET and the "off" codes
+  }
+}
+
+struct Result {
+  bool ok;
+  std::string failure;
+  uint64_t bytes;     // Sent by display()
+  int frames;         // Frames checked
+};
+
+static bool compare(qANSI_VT &vt, const RefTerminal &term, int posX, int posY, std::string &failure) {
+  for (int y = 1; y <= vt.height(); y++) {
+    for (int x = 1; x <= vt.width(); x++) {
+      AnsiCell want = vt.getCellAt(x, y);
+      const RefTerminal::Cell &got = term.cell(posX + x - 1, posY + y - 1);
+      if (got.ch != want.character || got.fg != want.fgColor || got.bg != want.bgColor ||
+          got.attrs != attributeBits(want.attributes)) {
+        char buf[160];
+        snprintf(buf, sizeof(buf),
+                 "cell (%d,%d): buffer '%c' fg %d bg %d attr %d, terminal '%c' fg %d bg %d attr bits 0x%02x\n",
+                 x, y, want.character, want.fgColor, want.bgColor, want.attributes,
+                 got.ch, got.fg, got.bg, got.attrs);
+        failure = buf;
+        for (int row = 1; row <= vt.height(); row++) {
+          std::string line;
+          for (int col = 1; col <= vt.width(); col++) line += vt.getCharAt(col, row);
+          failure += "  buffer   |" + line + "|   terminal |" +
+                     term.row(posY + row - 1, posX, posX + vt.width() - 1) + "|\n";
+        }
+        return false;
+      }
+    }
+  }
+  if (vt.isCursorVisible() != term.cursorVisible()) {
+    failure = "cursor visibility differs\n";
+    return false;
+  }
+  return true;
+}
+
+// Save a snapshot, paint it on a fresh model and restore it into a second
+// terminal that showed other contents before: both must match the buffer
+static bool checkSnapshot(qANSI_VT &vt, int posX, int posY, int runModes, std::string &failure) {
+  std::vector<uint8_t> data(vt.getSnapshotSize());
+  if (vt.saveSnapshot(data.data(), data.size()) != data.size() ||
+      vt.saveSnapshot(data.data(), data.size() - 1) != 0) {
+    failure = "snapshot size differs from getSnapshotSize()\n";
+    return false;
+  }
+
+  RefTerminal viewer(SCREEN_WIDTH, SCREEN_HEIGHT);
+  viewer.setBackgroundColorErase(false);
+  qANSI_VT::paintSnapshot(viewer, data.data(), data.size(), runModes);
+  if (!compare(vt, viewer, posX, posY, failure)) {
+    failure = "snapshot paint: " + failure;
+    return false;
+  }
+  if (vt.isCursorVisible() &&
+      (viewer.cursorX() != posX + min(vt.getCursorX(), vt.width()) - 1 ||
+       viewer.cursorY() != posY + min(vt.getCursorY(), vt.height()) - 1)) {
+    failure = "snapshot paint: cursor position differs\n";
+    return false;
+  }
+
+  RefTerminal term(SCREEN_WIDTH, SCREEN_HEIGHT);
+  qANSI_VT copy(vt.width(), vt.height(), 1, 1, term);
+  copy.begin();
+  copy.print("|14|B1previous contents");
+  copy.display();
+  if (!copy.restoreSnapshot(data.data(), data.size())) {
+    failure = "snapshot not restored\n";
+    return false;
+  }
+  copy.display();
+  if (!compare(copy, term, posX, posY, failure)) {
+    failure = "snapshot restore: " + failure;
+    return false;
+  }
+  if (copy.getCursorX() != vt.getCursorX() || copy.getCursorY() != vt.getCursorY() ||
+      copy.getCurrentFgColor() != vt.getCurrentFgColor() ||
+      copy.getCurrentBgColor() != vt.getCurrentBgColor() ||
+      copy.getCurrentAttribute() != vt.getCurrentAttribute() ||
+      copy.isLineWrappingEnabled() != vt.isLineWrappingEnabled() ||
+      copy.getPositionX() != vt.getPositionX() || copy.getPositionY() != vt.getPositionY()) {
+    failure = "snapshot restore: cursor, style or position differs\n";
+    return false;
+  }
+  return true;
+}
+
+// Print a QANSI_PIPE literal and check it against the same text parsed at
+// runtime by a terminal restored from a snapshot (so a code left unfinished
+// by an earlier print() is not part of it)
+static bool checkPipeLiteral(qANSI_VT &vt, int literal, std::string &failure) {
+  std::vector<uint8_t> data(vt.getSnapshotSize());
+  vt.saveSnapshot(data.data(), data.size());
+  CaptureStream out;
+  qANSI_VT expected(vt.width(), vt.height(), 1, 1, out);
+  expected.begin();
+  expected.restoreSnapshot(data.data(), data.size());
+  expected.setScrolling(vt.isScrollingEnabled());
+  expected.print(pipeLiteralSource[literal]);
+
+  vt.print(pipeLiteral(literal));
+  for (int y = 1; y <= vt.height(); y++) {
+    for (int x = 1; x <= vt.width(); x++) {
+      AnsiCell want = expected.getCellAt(x, y), got = vt.getCellAt(x, y);
+      if (got.character != want.character || got.fgColor != want.fgColor ||
+          got.bgColor != want.bgColor || got.attributes != want.attributes) {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "pipe literal: cell (%d,%d) is '%c', parsed at runtime '%c'\n",
+                 x, y, got.character, want.character);
+        failure = buf;
+        return false;
+      }
+    }
+  }
+  if (vt.getCursorX() != expected.getCursorX() || vt.getCursorY() != expected.getCursorY() ||
+      vt.getCurrentFgColor() != expected.getCurrentFgColor() ||
+      vt.getCurrentBgColor() != expected.getCurrentBgColor() ||
+      vt.getCurrentAttribute() != expected.getCurrentAttribute()) {
+    failure = "pipe literal: cursor or style differs from the runtime codes\n";
+    return false;
+  }
+  return true;
+}
+
+// Run the case against the model, or (baseline) with a full redraw per frame
+static Result run(const Case &c, bool baseline = false) {
+  Result result = { true, "", 0, 0 };
+  RefTerminal term(SCREEN_WIDTH, SCREEN_HEIGHT), mirror(SCREEN_WIDTH, SCREEN_HEIGHT);
+  // The output must not depend on background color erase
+  term.setBackgroundColorErase(false);
+  RefTerminal remote(SCREEN_WIDTH, SCREEN_HEIGHT);
+  LoopbackLink link;
+  int mirrorId = -1, syncId = -1;
+  qANSI_VT vt(c.width, c.height, c.posX, c.posY, term);
+  vt.begin();
+  int posX = c.posX, posY = c.posY;
+
+  // Custom codes: "HI" is redefined by the operations
+  qANSI_PipeTable table;
+  table.define("LO", "|12|17");
+  table.define("HI", "|14");
+  vt.setPipeTable(&table);
+
+  // A 4x3 sprite with a transparent middle row
+  AnsiCell image[12], saved[12];
+  for (int i = 0; i < 12; i++) {
+    AnsiCell cell = { i / 4 == 1 ? '.' : (char)('A' + i), (uint8_t)(31 + i % 7), 44, 0, false };
+    image[i] = cell;
+  }
+  qANSI_Sprite sprite(image, 4, 3, saved, '.');
+
+  for (size_t i = 0; i <= c.ops.size() && result.ok; i++) {
+    // Every case ends with a complete frame
+    Op op;
+    op.kind = OP_DISPLAY;
+    op.link = LINK_DELIVER;
+    if (i < c.ops.size()) op = c.ops[i];
+    if (!baseline && (int)i == c.sinkAt) mirrorId = vt.addSink(mirror, c.sinkModes, qANSI_Budget(c.sinkBudget));
+    if (!baseline && (int)i == c.syncAt) {
+      syncId = vt.addSyncSink(link, LoopbackLink::frameSent, &link, c.syncModes, qANSI_Budget(c.syncBudget));
+    }
+
+    bool complete = false;
+    switch (op.kind) {
+      case OP_WRITE: vt.print(op.text.c_str()); break;
+      case OP_SET_CURSOR: vt.setCursor(op.a, op.b); break;
+      case OP_SCROLL_UP: vt.scrollUp(op.a); break;
+      case OP_CLEAR: vt.clear(op.a != 0); break;
+      case OP_SET_POSITION: vt.setPosition(op.a, op.b); posX = op.a; posY = op.b; break;
+      case OP_FORCE_REDRAW: vt.forceFullRedraw(); break;
+      case OP_SET_COLOR: vt.setTextColor(op.a); break;
+      case OP_SET_BACKGROUND: vt.setTextBackgroundColor(op.a); break;
+      case OP_SET_ATTRIBUTE: vt.setTextAttribute(op.a); break;
+      case OP_SET_WRAPPING: vt.setLineWrapping(op.a != 0); break;
+      case OP_SET_CURSOR_VISIBLE: vt.setCursorVisible(op.a != 0); break;
+      case OP_FILL_RECT: vt.fillRect(op.a, op.b, op.w, op.h, op.text[0]); break;
+      case OP_DRAW_BOX: vt.drawBox(op.a, op.b, op.w, op.h); break;
+      case OP_SET_RUN_COMPRESSION: vt.setRunCompression(op.a); break;
+      case OP_BLIT: vt.blit(vt, qANSI_Rect(op.a, op.b, op.w, op.h), op.x, op.y); break;
+      case OP_SHOW_SPRITE: vt.showSprite(sprite, op.a, op.b); break;
+      case OP_HIDE_SPRITE: vt.hideSprite(sprite); break;
+      case OP_FRONT_BUFFER: vt.enableFrontBuffer(op.a != 0); break;
+      case OP_SET_SCROLLING: vt.setScrolling(op.a != 0); break;
+      case OP_DEFINE_CODE:
+        if (!checkDefine(table, op.text, op.a, result.failure)) result.ok = false;
+        break;
+      case OP_PIPE_LITERAL:
+        if (!checkPipeLiteral(vt, op.a, result.failure)) result.ok = false;
+        break;
+      case OP_SNAPSHOT:
+        if (!baseline && !checkSnapshot(vt, posX, posY, op.a, result.failure)) result.ok = false;
+        break;
+      case OP_DISPLAY:
+      case OP_DISPLAY_BUDGET:
+        if (baseline) {
+          vt.forceFullRedraw();
+          while (!vt.display()) result.bytes += vt.getLastDisplayBytes();
+          complete = true;
+        } else {
+          complete = vt.display(op.kind == OP_DISPLAY ? qANSI_Budget() : qANSI_Budget(op.a));
+        }
+        result.bytes += vt.getLastDisplayBytes();
+        break;
+    }
+    if (complete) {
+      result.frames++;
+      if (!baseline && !compare(vt, term, posX, posY, result.failure)) result.ok = false;
+    }
+    bool displayed = op.kind == OP_DISPLAY || op.kind == OP_DISPLAY_BUDGET;
+    if (result.ok && displayed && mirrorId >= 0 && !vt.isSinkPending(mirrorId) &&
+        !compare(vt, mirror, posX, posY, result.failure)) {
+      result.failure = "sink: " + result.failure;
+      result.ok = false;
+    }
+    if (result.ok && displayed && syncId >= 0 && link.inFlight) {
+      if (op.link == LINK_DELIVER) {
+        vt.acknowledgeSink(syncId, link.deliver(remote));
+      } else if (op.link == LINK_DROP) {
+        link.drop();
+        vt.dropSinkFrame(syncId);
+      }
+    }
+    if (result.ok && displayed && syncId >= 0 && !vt.isSinkPending(syncId) &&
+        !compare(vt, remote, posX, posY, result.failure)) {
+      result.failure = "state sync sink: " + result.failure;
+      result.ok = false;
+    }
+  }
+  return result;
+}
+
+// Remove operations while the case keeps failing
+static Case shrink(Case c) {
+  for (size_t chunk = c.ops.size() / 2; chunk >= 1; chunk /= 2) {
+    bool removed = true;
+    while (removed) {
+      removed = false;
+      for (size_t start = 0; start + chunk <= c.ops.size(); start++) {
+        Case smaller = c;
+        smaller.ops.erase(smaller.ops.begin() + start, smaller.ops.begin() + start + chunk);
+        if (!run(smaller).ok) {
+          c = smaller;
+          removed = true;
+          break;
+        }
+      }
+    }
+  }
+  return c;
+}
+
+int main(int argc, char **argv) {
+  int cases = 500, opCount = 40;
+  unsigned seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--cases")) cases = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--ops")) opCount = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--seed")) seed = strtoul(argv[i + 1], nullptr, 10);
+  }
+
+  uint64_t bytes = 0, baselineBytes = 0;
+  int frames = 0;
+  for (int n = 0; n < cases; n++) {
+    rng.seed(seed + n);
+    Case c = randomCase(opCount);
+    Result result = run(c);
+    if (!result.ok) {
+      Case minimal = shrink(c);
+      Result failed = run(minimal);
+      printf("FAIL: seed %u, minimal sequence (%zu of %zu operations):\n\n", seed + n,
+             minimal.ops.size(), c.ops.size());
+      printf("  qANSI_VT vt(%d, %d, %d, %d, terminal);\n  vt.begin();\n", minimal.width, minimal.height,
+             minimal.posX, minimal.posY);
+      printf("  // sprite: the 4x3 sprite set up in run()\n");
+      printf("  // table: \"LO\" = \"|12|17\", \"HI\" = \"|14\", set up in run()\n");
+      printf("  // sink: added before operation %d, modes %d, budget %d\n", minimal.sinkAt,
+             minimal.sinkModes, minimal.sinkBudget);
+      printf("  // state sync sink: added before operation %d, modes %d, budget %d\n", minimal.syncAt,
+             minimal.syncModes, minimal.syncBudget);
+      for (size_t i = 0; i < minimal.ops.size(); i++) printf("  %s\n", describe(minimal.ops[i]).c_str());
+      printf("  vt.display();\n\n%s", failed.failure.c_str());
+      return 1;
+    }
+    bytes += result.bytes;
+    baselineBytes += run(c, true).bytes;
+    frames += result.frames;
+  }
+
+  printf("%d cases, %d frames match the reference terminal\n", cases, frames);
+  printf("display() sent %llu bytes, full redraw every frame %llu bytes (%.1f%%)\n",
+         (unsigned long long)bytes, (unsigned long long)baselineBytes,
+         baselineBytes ? 100.0 * bytes / baselineBytes : 0);
+  return 0;
+}
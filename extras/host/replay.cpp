@@ -0,0 +1,295 @@
+/*
+ * replay.cpp - Play back and summarize qANSI_Recorder sessions
+ *
+ * Usage: replay [options] session.cast
+ *   --play        Write the output to stdout, paced like the recording
+ *   --speed X     Playback speed factor for --play (default 1)
+ *   --baud N      Simulate a serial link of N baud (8N1): output cannot
+ *                 leave faster than the link, so frames queue up
+ *   --frames      Print one line per frame
+ *   replay --demo > demo.cast   writes a short sample recording
+ *
+ * A frame is all output up to a "frame ..." marker (written by
+ * qANSI_Recorder::markFrame()). Its latency is the time from its first
+ * recorded byte until its last byte has left: the recorded time without
+ * --baud, the simulated link time with it.
+ */
+
+// Standard headers first: Arduino.h defines min() and max() as macros
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define QANSI_ENABLE_STATS 1
+#include <qANSI.h>
+#include <qANSI_VT.h>
+#include <qANSI_Recorder.h>
+#include "HostStreams.h"
+
+// --- Asciicast Parsing ---
+
+struct Event {
+  double time;
+  char type;          // 'o', 'i' or 'm'
+  std::string data;
+};
+
+static void appendUtf8(std::string &s, unsigned code) {
+  if (code < 0x80) {
+    s += (char)code;
+  } else if (code < 0x800) {
+    s += (char)(0xC0 | (code >> 6));
+    s += (char)(0x80 | (code & 0x3F));
+  } else {
+    s += (char)(0xE0 | (code >> 12));
+    s += (char)(0x80 | ((code >> 6) & 0x3F));
+    s += (char)(0x80 | (code & 0x3F));
+  }
+}
+
+// Decode the JSON string starting after the opening quote at p
+static const char *parseString(const char *p, std::string &out) {
+  while (*p && *p != '"') {
+    if (*p != '\\') {
+      out += *p++;
+      continue;
+    }
+    p++;
+    switch (*p) {
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'u': {
+        unsigned code = 0;
+        if (sscanf(p + 1, "%4x", &code) != 1) return nullptr;
+        // \u0080..ÿ are raw bytes in qANSI_Recorder files
+        if (code < 0x100) {
+          out += (char)code;
+        } else {
+          appendUtf8(out, code);
+        }
+        p += 4;
+        break;
+      }
+      default: out += *p; break;
+    }
+    if (*p) p++;
+  }
+  return *p == '"' ? p + 1 : nullptr;
+}
+
+static bool parseEvent(const char *line, Event &event) {
+  char type;
+  int consumed = 0;
+  if (sscanf(line, " [ %lf , \"%c\" , \"%n", &event.time, &type, &consumed) != 2 || !consumed) {
+    return false;
+  }
+  event.type = type;
+  event.data.clear();
+  return parseString(line + consumed, event.data) != nullptr;
+}
+
+static bool readCast(const char *path, std::vector<Event> &events) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  std::string line;
+  char buf[4096];
+  bool header = true;
+  while (fgets(buf, sizeof(buf), f)) {
+    line += buf;
+    if (line.empty() || line[line.size() - 1] != '\n') continue;
+    if (header) {
+      header = false; // {"version": 2, ...}
+    } else {
+      Event event;
+      if (parseEvent(line.c_str(), event)) events.push_back(event);
+    }
+    line.clear();
+  }
+  fclose(f);
+  return true;
+}
+
+// Value of "key=" in a frame marker, or -1
+static long markerField(const std::string &label, const char *key) {
+  std::string pattern = std::string(" ") + key + "=";
+  size_t pos = label.find(pattern);
+  return pos == std::string::npos ? -1 : atol(label.c_str() + pos + pattern.size());
+}
+
+// --- Summary ---
+
+struct Frame {
+  double start;      // Recorded time of the first byte
+  double done;       // Time the last byte has left
+  size_t bytes;
+  std::string label;
+};
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t i = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[i];
+}
+
+static void printDistribution(const char *name, const std::vector<double> &values, const char *unit) {
+  if (values.empty()) return;
+  double sum = 0;
+  for (size_t i = 0; i < values.size(); i++) sum += values[i];
+  printf("%-22s min %9.1f  avg %9.1f  p95 %9.1f  max %9.1f %s\n", name, percentile(values, 0),
+         sum / values.size(), percentile(values, 0.95), percentile(values, 1), unit);
+}
+
+static void summarize(const std::vector<Event> &events, long baud, bool perFrame) {
+  std::vector<Frame> frames;
+  Frame current = { 0, 0, 0, "" };
+  double linkFree = 0;  // Simulated time the link finishes the queued bytes
+  size_t totalBytes = 0;
+  double lastTime = 0;
+
+  for (size_t i = 0; i < events.size(); i++) {
+    const Event &e = events[i];
+    lastTime = e.time;
+    if (e.type == 'o') {
+      if (current.bytes == 0) current.start = e.time;
+      current.bytes += e.data.size();
+      totalBytes += e.data.size();
+      if (baud > 0) {
+        linkFree = (linkFree > e.time ? linkFree : e.time) + e.data.size() * 10.0 / baud;
+        current.done = linkFree;
+      } else {
+        current.done = e.time;
+      }
+    } else if (e.type == 'm' && e.data.compare(0, 6, "frame ") == 0) {
+      current.label = e.data;
+      if (current.bytes == 0) current.start = current.done = e.time;
+      frames.push_back(current);
+      current = Frame();
+    }
+  }
+
+  printf("duration              %.3f s, %zu bytes, %zu frames\n", lastTime, totalBytes, frames.size());
+  if (frames.empty()) {
+    printf("no frame markers (record with qANSI_Recorder::markFrame())\n");
+    return;
+  }
+
+  std::vector<double> sizes, latencies, cpu;
+  long strategies[4] = { 0 }, reasons[4] = { 0 };
+  for (size_t i = 0; i < frames.size(); i++) {
+    const Frame &f = frames[i];
+    double latency = (f.done - f.start) * 1000.0;
+    sizes.push_back(f.bytes);
+    latencies.push_back(latency);
+    long us = markerField(f.label, "us");
+    if (us >= 0) cpu.push_back(us);
+    long strategy = markerField(f.label, "strategy");
+    long reason = markerField(f.label, "reason");
+    if (strategy >= 0 && strategy < 4) strategies[strategy]++;
+    if (reason > 0 && reason < 4) reasons[reason]++;
+    if (perFrame) {
+      printf("frame %5zu  t=%9.3f s  %6zu bytes  latency %8.2f ms  %s\n", i + 1, f.start, f.bytes,
+             latency, f.label.c_str() + 6);
+    }
+  }
+
+  printDistribution("bytes/frame", sizes, "bytes");
+  printDistribution(baud > 0 ? "latency (simulated)" : "latency (recorded)", latencies, "ms");
+  printDistribution("display() time", cpu, "us");
+  if (strategies[1] + strategies[2] + strategies[3]) {
+    printf("strategies            full %ld  sparse %ld  rows %ld\n", strategies[1], strategies[2], strategies[3]);
+    printf("full redraws          forced %ld  scroll %ld  threshold %ld\n", reasons[1], reasons[2], reasons[3]);
+  }
+  if (baud > 0) {
+    printf("link                  %ld baud, %.3f s to send %.3f s of output\n", baud,
+           totalBytes * 10.0 / baud, lastTime);
+  }
+}
+
+// --- Playback ---
+
+static void play(const std::vector<Event> &events, double speed, long baud) {
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  double linkFree = 0;
+  for (size_t i = 0; i < events.size(); i++) {
+    const Event &e = events[i];
+    if (e.type != 'o') continue;
+    double at = e.time;
+    if (baud > 0) {
+      at = linkFree > e.time ? linkFree : e.time;
+      linkFree = at + e.data.size() * 10.0 / baud;
+    }
+    std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                                              std::chrono::duration<double>(at / speed)));
+    fwrite(e.data.data(), 1, e.data.size(), stdout);
+    fflush(stdout);
+  }
+}
+
+// --- Demo Recording ---
+
+static void demo() {
+  CountingStream terminal;
+  HostPrint log(stdout);
+  qANSI_Recorder recorder(terminal, log, 40, 12);
+  qANSI_VT vt(40, 12, 1, 1, recorder);
+  recorder.begin();
+  vt.begin();
+  vt.display();
+  recorder.markFrame(vt);
+  for (int i = 0; i < 30; i++) {
+    vt.print("|08");
+    vt.print(i);
+    vt.print(" |07reading |15");
+    vt.println(i * 37 % 100);
+    vt.display();
+    recorder.markFrame(vt);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  recorder.end();
+}
+
+int main(int argc, char **argv) {
+  const char *path = nullptr;
+  bool doPlay = false, perFrame = false;
+  double speed = 1;
+  long baud = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--play")) {
+      doPlay = true;
+    } else if (!strcmp(argv[i], "--frames")) {
+      perFrame = true;
+    } else if (!strcmp(argv[i], "--speed") && i + 1 < argc) {
+      speed = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+      baud = atol(argv[++i]);
+    } else if (!strcmp(argv[i], "--demo")) {
+      demo();
+      return 0;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path || speed <= 0) {
+    fprintf(stderr, "usage: replay [--play] [--speed X] [--baud N] [--frames] session.cast\n");
+    return 1;
+  }
+
+  std::vector<Event> events;
+  if (!readCast(path, events)) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return 1;
+  }
+  if (doPlay) {
+    play(events, speed, baud);
+  } else {
+    summarize(events, baud, perFrame);
+  }
+  return 0;
+}
@@ -0,0 +1,486 @@
+/*
+ * wirebytes.cpp - Wire-byte regression check for qANSI_VT
+ *
+ * Usage: wirebytes [--update] [budget file]
+ *
+ * Replays scripted workloads into a byte-counting stream and compares the
+ * bytes and escape sequences sent with the budgets checked in to
+ * wirebytes.budget. Prints a table of all scenarios. Exits with 1 if a
+ * scenario is over its budget or has no budget. Improvements pass but are
+ * reported, run with --update to record the new numbers.
+ */
+
+// Standard headers first: Arduino.h defines min() and max() as macros
+#include <map>
+#include <string>
+#include <vector>
+
+#include <qANSI.h>
+#include <qANSI_VT.h>
+#include "HostStreams.h"
+
+// --- Scenarios ---
+
+typedef void (*Scenario)(CountingStream &out);
+
+// A log that scrolls one line per frame
+static void scrollingLog(CountingStream &out) {
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  for (int i = 0; i < 60; i++) {
+    vt.print("|08[");
+    vt.print(1000 + i * 37);
+    vt.print("] |07sensor |15");
+    vt.print(i % 7);
+    vt.print("|07 reading=");
+    vt.println((i * 7919) % 1000);
+    vt.display();
+  }
+}
+
+// A log that prints several lines between frames, without scrolling
+static void batchedLog(CountingStream &out) {
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  vt.setScrolling(false);
+  for (int frame = 0; frame < 6; frame++) {
+    for (int i = 0; i < 4; i++) {
+      vt.setCursor(1, 1 + frame * 4 + i);
+      vt.print("|10OK   |07job ");
+      vt.print(frame * 4 + i);
+      vt.print(" finished in ");
+      vt.print((frame * 31 + i * 17) % 400);
+      vt.print(" ms");
+    }
+    vt.display();
+  }
+}
+
+// Labels drawn once, ten counters updated every frame
+static void counterDashboard(CountingStream &out) {
+  qANSI_VT vt(60, 22, 1, 1, out);
+  vt.begin();
+  for (uint8_t i = 0; i < 10; i++) {
+    vt.setCursor(2, 2 + i * 2);
+    vt.print("|15Channel ");
+    vt.print(i);
+    vt.print(":|RA");
+  }
+  vt.display();
+  for (uint32_t tick = 1; tick <= 50; tick++) {
+    for (uint8_t i = 0; i < 10; i++) {
+      vt.setCursor(16, 2 + i * 2);
+      vt.setTextColor(tick * (i + 1) % 50 < 40 ? qANSI_Colors::FG_GREEN : qANSI_Colors::FG_RED);
+      vt.print((unsigned long)(tick * (i + 1) * 13));
+      vt.print("   ");
+    }
+    vt.display();
+  }
+}
+
+// The same counters as bound fields: only digits that change are sent
+static void fieldDashboard(CountingStream &out) {
+  qANSI_VT vt(60, 22, 1, 1, out);
+  vt.begin();
+  unsigned long values[10] = { 0 };
+  for (uint8_t i = 0; i < 10; i++) {
+    vt.setCursor(2, 2 + i * 2);
+    vt.print("|15Channel ");
+    vt.print(i);
+    vt.print(":|RA");
+    vt.setTextColor(qANSI_Colors::FG_GREEN);
+    vt.bindField(16, 2 + i * 2, &values[i], qANSI_NumberFormat(8, 0, ' ', qANSI_NumberFormat::LEFT));
+  }
+  vt.refreshFields();
+  vt.display();
+  for (uint32_t tick = 1; tick <= 50; tick++) {
+    for (uint8_t i = 0; i < 10; i++) {
+      values[i] = tick * (i + 1) * 13;
+    }
+    vt.refreshFields();
+    vt.display();
+  }
+}
+
+// The counter dashboard mirrored to a second stream that attaches halfway
+// (bytes of both streams)
+static void mirroredDashboard(CountingStream &out) {
+  qANSI_VT vt(60, 22, 1, 1, out);
+  vt.begin();
+  for (uint8_t i = 0; i < 10; i++) {
+    vt.setCursor(2, 2 + i * 2);
+    vt.print("|15Channel ");
+    vt.print(i);
+    vt.print(":|RA");
+  }
+  vt.display();
+  for (uint32_t tick = 1; tick <= 50; tick++) {
+    if (tick == 25) vt.addSink(out, qANSI_VT::RUN_ERASE | qANSI_VT::RUN_REPEAT);
+    for (uint8_t i = 0; i < 10; i++) {
+      vt.setCursor(16, 2 + i * 2);
+      vt.setTextColor(tick * (i + 1) % 50 < 40 ? qANSI_Colors::FG_GREEN : qANSI_Colors::FG_RED);
+      vt.print((unsigned long)(tick * (i + 1) * 13));
+      vt.print("   ");
+    }
+    vt.display();
+  }
+}
+
+// The counter dashboard on a state sync sink behind a link that delivers a
+// frame every fourth tick (bytes over the link, the own output is discarded)
+static void slowLink(CountingStream &out) {
+  CountingStream local;
+  LoopbackLink link;
+  qANSI_VT vt(60, 22, 1, 1, local);
+  vt.begin();
+  vt.addSyncSink(link, LoopbackLink::frameSent, &link, qANSI_VT::RUN_ERASE | qANSI_VT::RUN_REPEAT);
+  for (uint8_t i = 0; i < 10; i++) {
+    vt.setCursor(2, 2 + i * 2);
+    vt.print("|15Channel ");
+    vt.print(i);
+    vt.print(":|RA");
+  }
+  vt.display();
+  for (uint32_t tick = 1; tick <= 50; tick++) {
+    for (uint8_t i = 0; i < 10; i++) {
+      vt.setCursor(16, 2 + i * 2);
+      vt.setTextColor(tick * (i + 1) % 50 < 40 ? qANSI_Colors::FG_GREEN : qANSI_Colors::FG_RED);
+      vt.print((unsigned long)(tick * (i + 1) * 13));
+      vt.print("   ");
+    }
+    vt.display();
+    if (tick % 4 == 0 && link.inFlight) vt.acknowledgeSink(0, link.deliver(out));
+  }
+  while (link.inFlight) {
+    vt.acknowledgeSink(0, link.deliver(out));
+    vt.display();
+  }
+}
+
+// A menu whose highlighted entry moves down and back up
+static void menu(CountingStream &out) {
+  static const char *items[] = { "Status", "Network", "Sensors", "Logging", "Firmware", "Reboot" };
+  qANSI_VT vt(30, 10, 20, 5, out);
+  vt.begin();
+  for (int step = 0; step < 12; step++) {
+    int selected = step < 6 ? step : 11 - step;
+    for (int i = 0; i < 6; i++) {
+      vt.setCursor(2, 2 + i);
+      if (i == selected) {
+        vt.setTextColor(qANSI_Colors::FG_BLACK, qANSI_Colors::BG_WHITE);
+      } else {
+        vt.setTextColor(qANSI_Colors::FG_DEFAULT, qANSI_Colors::BG_DEFAULT);
+      }
+      vt.print(" ");
+      vt.print(items[i]);
+      vt.print("              ");
+    }
+    vt.display();
+  }
+}
+
+// A window that is moved around the screen and redrawn
+static void movingWindow(CountingStream &out) {
+  qANSI_VT vt(24, 6, 1, 1, out);
+  vt.begin();
+  vt.print("|14Moving window|RA\ncontents stay the same\nbut the position changes");
+  vt.display();
+  for (int i = 1; i <= 8; i++) {
+    vt.setPosition(1 + i * 5, 1 + i * 2);
+    vt.display();
+  }
+}
+
+// Single cells changing in random places
+static void sparseUpdates(CountingStream &out) {
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  uint16_t n = 0;
+  for (int i = 0; i < 200; i++) {
+    n = n * 75 + 74;
+    vt.setCursor(1 + n % 80, 1 + (n / 80) % 24);
+    vt.setTextColor(31 + n % 7);
+    vt.write((uint8_t)('0' + i % 10));
+    vt.display();
+  }
+}
+
+// Captured ANSI output (colored listing and progress bar) replayed into a VT
+static void ansiCapture(CountingStream &out) {
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  for (int frame = 0; frame <= 20; frame++) {
+    vt.print("\033[1;1H\033[1;34msrc\033[0m  \033[1;32mbuild.sh\033[0m  README.md\r\n");
+    vt.print("\033[2;1HDownloading [");
+    for (int i = 0; i < 20; i++) vt.print(i < frame ? "#" : " ");
+    vt.print("] ");
+    vt.print(frame * 5);
+    vt.print("%\033[K");
+    vt.display();
+  }
+}
+
+// A budget-limited full redraw over a slow link
+static void budgetedRedraw(CountingStream &out) {
+  qANSI_VT vt(40, 12, 1, 1, out);
+  vt.begin();
+  for (uint8_t y = 1; y <= 12; y++) {
+    vt.setCursor(1, y);
+    vt.setTextColor(31 + y % 7);
+    vt.print("0123456789abcdefghijklmnopqrstuvwxyz");
+  }
+  while (!vt.display(qANSI_Budget(64))) {}
+}
+
+// Boxed panels with filled backgrounds and bar gauges
+static void drawPanels(qANSI_VT &vt) {
+  for (uint8_t i = 0; i < 3; i++) {
+    vt.setTextColor(qANSI_Colors::FG_CYAN, qANSI_Colors::BG_BLUE);
+    vt.drawBox(1 + i * 27, 1, 26, 12, qANSI_Box::DOUBLE);
+    vt.clearRect(2 + i * 27, 2, 24, 10);
+  }
+  vt.setTextColor(qANSI_Colors::FG_DEFAULT, qANSI_Colors::BG_DEFAULT);
+  vt.drawBox(1, 13, 80, 12);
+  vt.display();
+  for (int frame = 0; frame < 30; frame++) {
+    for (uint8_t bar = 0; bar < 8; bar++) {
+      uint8_t level = (frame * (bar + 3) * 7) % 78;
+      vt.setTextColor(level > 60 ? qANSI_Colors::FG_RED : qANSI_Colors::FG_GREEN);
+      vt.fillRect(2, 14 + bar, level, 1, '#');
+      vt.clearRect(2 + level, 14 + bar, 78 - level, 1);
+    }
+    vt.display();
+  }
+}
+
+// The panels on a terminal with REP
+static void panels(CountingStream &out) {
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  vt.setRunCompression(qANSI_VT::RUN_ERASE | qANSI_VT::RUN_REPEAT);
+  drawPanels(vt);
+}
+
+// A viewer attaching to the panels, sent a full redraw (only the viewer's
+// bytes count)
+static void reattachRedraw(CountingStream &out) {
+  CountingStream local;
+  qANSI_VT vt(80, 24, 1, 1, local);
+  vt.begin();
+  drawPanels(vt);
+  vt.addSink(out, qANSI_VT::RUN_ERASE | qANSI_VT::RUN_REPEAT);
+  vt.display();
+}
+
+// The same viewer sent the catch-up paint of a snapshot
+static void reattachSnapshot(CountingStream &out) {
+  CountingStream local;
+  qANSI_VT vt(80, 24, 1, 1, local);
+  vt.begin();
+  drawPanels(vt);
+  uint8_t snapshot[4096];
+  size_t size = vt.saveSnapshot(snapshot, sizeof(snapshot));
+  qANSI_VT::paintSnapshot(out, snapshot, size, qANSI_VT::RUN_ERASE | qANSI_VT::RUN_REPEAT);
+}
+
+// A popup sprite sliding over a text screen, then a page copied in from a
+// template terminal
+static void popup(CountingStream &out) {
+  qANSI_VT vt(80, 24, 1, 1, out);
+  vt.begin();
+  vt.setScrolling(false);
+  for (uint8_t y = 1; y <= 24; y++) {
+    vt.setCursor(1, y);
+    vt.print("|07");
+    for (uint8_t x = 0; x < 8; x++) vt.print("log entry ");
+  }
+  vt.display();
+  
+  AnsiCell image[24 * 5], saved[24 * 5];
+  for (uint8_t i = 0; i < 24 * 5; i++) {
+    bool border = i < 24 || i >= 4 * 24 || i % 24 == 0 || i % 24 == 23;
+    AnsiCell cell = { border ? '#' : ' ', qANSI_Colors::FG_YELLOW, qANSI_Colors::BG_BLUE, 0, false };
+    image[i] = cell;
+  }
+  qANSI_Sprite sprite(image, 24, 5, saved);
+  for (uint8_t step = 0; step < 20; step++) {
+    vt.showSprite(sprite, 2 + step * 2, 3 + step / 2);
+    vt.display();
+  }
+  vt.hideSprite(sprite);
+  vt.display();
+  
+  CountingStream none;
+  qANSI_VT page(80, 12, 1, 1, none);
+  page.begin();
+  page.print("|15Status page\n|07uptime 12:00:31\nlink up");
+  vt.blit(page, qANSI_Rect(1, 1, 80, 12), 1, 13);
+  vt.display();
+}
+
+// A page cleared and printed again on every loop, with a few values
+// changing
+static void drawPage(qANSI_VT &vt) {
+  vt.begin();
+  for (uint32_t tick = 1; tick <= 30; tick++) {
+    vt.clear(false);
+    vt.print("|15Status|07\n\n");
+    for (uint8_t i = 0; i < 10; i++) {
+      vt.print("Channel ");
+      vt.print(i);
+      vt.print(": ");
+      vt.print((unsigned long)(i < 2 ? tick * (i + 1) * 13 : i * 100));
+      vt.print("\n");
+    }
+    vt.display();
+  }
+}
+
+static void redrawnPage(CountingStream &out) {
+  qANSI_VT vt(60, 16, 1, 1, out);
+  drawPage(vt);
+}
+
+// The same page with a front buffer: only cells that differ are sent
+static void redrawnPageFront(CountingStream &out) {
+  qANSI_VT vt(60, 16, 1, 1, out);
+  vt.enableFrontBuffer();
+  drawPage(vt);
+}
+
+struct ScenarioEntry {
+  const char *name;
+  Scenario run;
+};
+
+static const ScenarioEntry scenarios[] = {
+  { "scrolling-log", scrollingLog },
+  { "batched-log", batchedLog },
+  { "counter-dashboard", counterDashboard },
+  { "field-dashboard", fieldDashboard },
+  { "mirrored-dashboard", mirroredDashboard },
+  { "slow-link", slowLink },
+  { "menu", menu },
+  { "moving-window", movingWindow },
+  { "sparse-updates", sparseUpdates },
+  { "ansi-capture", ansiCapture },
+  { "budgeted-redraw", budgetedRedraw },
+  { "panels", panels },
+  { "reattach-redraw", reattachRedraw },
+  { "reattach-snapshot", reattachSnapshot },
+  { "popup", popup },
+  { "redrawn-page", redrawnPage },
+  { "redrawn-page-front", redrawnPageFront },
+};
+
+// --- Budget File ---
+
+struct Budget {
+  uint64_t bytes;
+  uint64_t escapes;
+};
+
+static bool readBudgets(const char *path, std::map<std::string, Budget> &budgets) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    char name[128];
+    unsigned long long bytes, escapes;
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%127s %llu %llu", name, &bytes, &escapes) == 3) {
+      Budget b = { bytes, escapes };
+      budgets[name] = b;
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static bool writeBudgets(const char *path, const std::vector<std::pair<std::string, Budget> > &results) {
+  FILE *f = fopen(path, "w");
+  if (!f) return false;
+  fprintf(f, "# Wire-byte budgets for wirebytes.cpp, updated with \"wirebytes --update\"\n");
+  fprintf(f, "# scenario              bytes  escapes\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    fprintf(f, "%-20s %8llu %8llu\n", results[i].first.c_str(),
+            (unsigned long long)results[i].second.bytes, (unsigned long long)results[i].second.escapes);
+  }
+  fclose(f);
+  return true;
+}
+
+static void printDelta(uint64_t budget, uint64_t actual) {
+  long long delta = (long long)actual - (long long)budget;
+  double percent = budget ? 100.0 * delta / budget : 0;
+  printf(" %9llu %9llu %+8lld %+7.1f%%", (unsigned long long)budget, (unsigned long long)actual, delta, percent);
+}
+
+int main(int argc, char **argv) {
+  bool update = false;
+  const char *path = "wirebytes.budget";
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--update")) {
+      update = true;
+    } else {
+      path = argv[i];
+    }
+  }
+
+  std::map<std::string, Budget> budgets;
+  if (!readBudgets(path, budgets) && !update) {
+    fprintf(stderr, "cannot read %s (run with --update to create it)\n", path);
+    return 1;
+  }
+
+  std::vector<std::pair<std::string, Budget> > results;
+  int regressions = 0, improvements = 0;
+  printf("%-20s %9s %9s %8s %8s  %9s %9s %8s %8s\n", "scenario", "bytes", "actual", "delta", "%",
+         "escapes", "actual", "delta", "%");
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    CountingStream out;
+    scenarios[i].run(out);
+    Budget actual = { out.bytes, out.escapes };
+    results.push_back(std::make_pair(std::string(scenarios[i].name), actual));
+
+    std::map<std::string, Budget>::const_iterator budget = budgets.find(scenarios[i].name);
+    const char *verdict;
+    if (budget == budgets.end()) {
+      verdict = "NEW";
+      if (!update) regressions++;
+      Budget none = { 0, 0 };
+      budget = budgets.insert(std::make_pair(std::string(scenarios[i].name), none)).first;
+    } else if (actual.bytes > budget->second.bytes || actual.escapes > budget->second.escapes) {
+      verdict = "REGRESSED";
+      if (!update) regressions++;
+    } else if (actual.bytes < budget->second.bytes || actual.escapes < budget->second.escapes) {
+      verdict = "improved";
+      improvements++;
+    } else {
+      verdict = "";
+    }
+
+    printf("%-20s", scenarios[i].name);
+    printDelta(budget->second.bytes, actual.bytes);
+    printf(" ");
+    printDelta(budget->second.escapes, actual.escapes);
+    printf("  %s\n", verdict);
+  }
+
+  if (update) {
+    if (!writeBudgets(path, results)) {
+      fprintf(stderr, "cannot write %s\n", path);
+      return 1;
+    }
+    printf("\nBudgets written to %s\n", path);
+    return 0;
+  }
+  if (improvements && !regressions) {
+    printf("\n%d scenario(s) improved, run \"wirebytes --update\" to lower the budgets\n", improvements);
+  }
+  if (regressions) {
+    printf("\n%d scenario(s) over budget\n", regressions);
+    return 1;
+  }
+  return 0;
+}
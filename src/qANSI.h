@@ -97,10 +97,208 @@ namespace qANSI_PipeCodes {
     const char* REVERSE_OFF     = "|R0";  // Reverse off
 }
 
+// --- Compile-time sequence builder ---
+#include "qANSI_Seq.h"
+
+// --- Number formatting ---
+#include "qANSI_Format.h"
+
+// --- User-defined pipe codes ---
+// Size of the hash table (power of two; also the maximum number of codes)
+#ifndef QANSI_PIPE_TABLE_SIZE
+#define QANSI_PIPE_TABLE_SIZE 16
+#endif
+
+// Bytes available for the pre-encoded expansions of one table
+#ifndef QANSI_PIPE_POOL_SIZE
+#define QANSI_PIPE_POOL_SIZE 96
+#endif
+
+// A set of user-defined pipe codes. Each code expands to pipe-coded text
+// (styles and/or macro text), which is encoded to its final ANSI bytes when
+// it is defined. Codes in the table take precedence over the built-in ones,
+// so a theme is a table that can be swapped with qANSI::setPipeTable().
+class qANSI_PipeTable {
+public:
+    struct Entry {
+        char key[2];           // key[0] == 0 marks an empty slot
+        uint16_t ansiOffset;   // Final ANSI bytes in the pool
+        uint8_t ansiLength;
+        uint16_t opsOffset;    // Text bytes and OP_STYLE/code pairs in the pool
+        uint8_t opsLength;
+    };
+    
+    // Marker in the ops stream: the next byte is an SGR code
+    static const uint8_t OP_STYLE = 0x01;
+    
+    qANSI_PipeTable() {
+        clear();
+    }
+    
+    // Remove all codes
+    void clear() {
+        memset(_entries, 0, sizeof(_entries));
+        _poolUsed = 0;
+    }
+    
+    // Define (or redefine) a two-character code, e.g. define("WA", "|14|25").
+    // The expansion may use built-in codes and codes defined earlier (also
+    // the code's own previous expansion). A redefinition gives the pool space
+    // of the old expansion back. Returns false if the code or expansion is
+    // invalid or the table is full.
+    bool define(const char *code, const char *expansion) {
+        if (!code || !code[0] || !code[1] || code[2] || !expansion) return false;
+        
+        Entry *slot = _slot(code[0], code[1]);
+        if (!slot) return false;
+        
+        // Ops first, then the ANSI bytes are generated from them
+        uint16_t opsOffset = _poolUsed;
+        while (*expansion) {
+            if (*expansion == '|') {
+                if (!expansion[1] || !expansion[2]) return _rollback(opsOffset);
+                const Entry *nested = find(expansion[1], expansion[2]);
+                if (nested) {
+                    if (!_append(_pool + nested->opsOffset, nested->opsLength)) return _rollback(opsOffset);
+                } else {
+                    uint8_t sgr = builtinSgr(expansion[1], expansion[2]);
+                    uint8_t op[2] = { OP_STYLE, sgr };
+                    if (sgr == 0xFF || !_append(op, 2)) return _rollback(opsOffset);
+                }
+                expansion += 3;
+            } else {
+                if (!_append((const uint8_t *)expansion, 1)) return _rollback(opsOffset);
+                expansion++;
+            }
+        }
+        uint16_t opsLength = _poolUsed - opsOffset;
+        
+        uint16_t ansiOffset = _poolUsed;
+        if (opsLength > 255 || !_encodeAnsi(opsOffset, opsLength)) return _rollback(opsOffset);
+        uint16_t ansiLength = _poolUsed - ansiOffset;
+        if (ansiLength > 255) return _rollback(opsOffset);
+        
+        if (slot->key[0]) {
+            _release(*slot);
+            opsOffset -= slot->opsLength + slot->ansiLength;
+            ansiOffset -= slot->opsLength + slot->ansiLength;
+        }
+        slot->key[0] = code[0];
+        slot->key[1] = code[1];
+        slot->opsOffset = opsOffset;
+        slot->opsLength = opsLength;
+        slot->ansiOffset = ansiOffset;
+        slot->ansiLength = ansiLength;
+        return true;
+    }
+    
+    // O(1) lookup (open addressing on the two key characters)
+    const Entry *find(char c1, char c2) const {
+        uint8_t h = _hash(c1, c2);
+        for (uint8_t i = 0; i < QANSI_PIPE_TABLE_SIZE; i++) {
+            const Entry &e = _entries[(h + i) & (QANSI_PIPE_TABLE_SIZE - 1)];
+            if (e.key[0] == 0) return nullptr;
+            if (e.key[0] == c1 && e.key[1] == c2) return &e;
+        }
+        return nullptr;
+    }
+    
+    const uint8_t *ansi(const Entry &e) const { return _pool + e.ansiOffset; }
+    const uint8_t *ops(const Entry &e) const { return _pool + e.opsOffset; }
+    
+    // SGR code of a built-in code (|00..|32 and the qANSI_PipeCodes letter
+    // codes), or 0xFF if it is not supported
+    static uint8_t builtinSgr(char c1, char c2) {
+        static const uint8_t numeric[33] PROGMEM = {
+            30, 34, 32, 36, 31, 35, 33, 37,     // |00..|07 foreground
+            90, 94, 92, 96, 91, 95, 93, 97,     // |08..|15 bright foreground
+            40, 44, 42, 46, 41, 45, 43, 47,     // |16..|23 background
+            0, 1, 4, 5, 7, 22, 24, 25, 27       // |24..|32 reset and attributes
+        };
+        if (c1 >= '0' && c1 <= '9' && c2 >= '0' && c2 <= '9') {
+            uint8_t code = (c1 - '0') * 10 + (c2 - '0');
+            return code <= 32 ? pgm_read_byte(&numeric[code]) : 0xFF;
+        }
+        return qANSI_Seq::pipeLetterSgr(c1, c2);
+    }
+    
+private:
+    Entry _entries[QANSI_PIPE_TABLE_SIZE];
+    uint8_t _pool[QANSI_PIPE_POOL_SIZE];
+    uint16_t _poolUsed;
+    
+    static uint8_t _hash(char c1, char c2) {
+        return ((uint8_t)c1 * 31 + (uint8_t)c2) & (QANSI_PIPE_TABLE_SIZE - 1);
+    }
+    
+    // Existing slot for the code, or a free one
+    Entry *_slot(char c1, char c2) {
+        uint8_t h = _hash(c1, c2);
+        for (uint8_t i = 0; i < QANSI_PIPE_TABLE_SIZE; i++) {
+            Entry &e = _entries[(h + i) & (QANSI_PIPE_TABLE_SIZE - 1)];
+            if (e.key[0] == 0 || (e.key[0] == c1 && e.key[1] == c2)) return &e;
+        }
+        return nullptr;
+    }
+    
+    bool _append(const uint8_t *data, uint16_t length) {
+        if (_poolUsed + length > QANSI_PIPE_POOL_SIZE) return false;
+        memmove(_pool + _poolUsed, data, length);
+        _poolUsed += length;
+        return true;
+    }
+    
+    // Remove the pool bytes of an entry (ops, then its ANSI bytes) and move
+    // the bytes after them down. Every later expansion, including one being
+    // defined at the end of the pool, moves by the same amount.
+    void _release(const Entry &old) {
+        uint16_t start = old.opsOffset;
+        uint16_t length = old.opsLength + old.ansiLength;
+        if (!length) return;
+        memmove(_pool + start, _pool + start + length, _poolUsed - start - length);
+        _poolUsed -= length;
+        for (uint8_t i = 0; i < QANSI_PIPE_TABLE_SIZE; i++) {
+            Entry &e = _entries[i];
+            if (e.key[0] && &e != &old && e.opsOffset > start) {
+                e.opsOffset -= length;
+                e.ansiOffset -= length;
+            }
+        }
+    }
+    
+    bool _rollback(uint16_t poolUsed) {
+        _poolUsed = poolUsed;
+        return false;
+    }
+    
+    // Append the ANSI bytes for an ops stream, merging adjacent SGR codes
+    bool _encodeAnsi(uint16_t offset, uint16_t length) {
+        bool inSgr = false;
+        for (uint16_t i = 0; i < length; i++) {
+            uint8_t op = _pool[offset + i];
+            if (op == OP_STYLE) {
+                char buf[8];
+                uint8_t n = sprintf(buf, inSgr ? ";%d" : "\033[%d", _pool[offset + ++i]);
+                if (!_append((const uint8_t *)buf, n)) return false;
+                inSgr = true;
+                continue;
+            }
+            if (inSgr && !_append((const uint8_t *)"m", 1)) return false;
+            inSgr = false;
+            if (!_append(&op, 1)) return false;
+        }
+        return !inSgr || _append((const uint8_t *)"m", 1);
+    }
+};
+
 class qANSI : public Print {
 public:
     // Constructor
-    qANSI(Stream &output = Serial) : _output(output), _cursorVisible(false), _pipeCodesEnabled(true) {
+    qANSI(Stream &output = Serial) : _output(output), _cursorVisible(false), _pipeCodesEnabled(true),
+                                     _pipeTable(nullptr),
+                                     _dedupEnabled(false), _knownState(0), _attrBits(0),
+                                     _trackedCol(1), _trackedRow(1), _savedCol(1), _savedRow(1),
+                                     _screenCols(80), _screenRows(24) {
         // Initialize state tracking
         _currentFg = qANSI_Colors::FG_DEFAULT;
         _currentBg = qANSI_Colors::BG_DEFAULT;
@@ -143,42 +341,57 @@ public:
     
     // Set cursor position (ANSI is 1-based)
     void setCursor(uint8_t col, uint8_t row) {
+        if (_dedupEnabled && (_knownState & KNOWN_CURSOR)) {
+            _moveCursorTo(col, row);
+            return;
+        }
         char posBuf[20];
         sprintf(posBuf, "\033[%d;%dH", row, col);
         _sendAnsiCommand(posBuf);
+        _trackCursor(col, row);
     }
     
     // Move cursor up
     void cursorUp(uint8_t lines = 1) {
+        if (lines == 0) return; // CSI 0 A would move by one
         char buf[15];
         sprintf(buf, "\033[%dA", lines);
         _sendAnsiCommand(buf);
+        _trackMove(_trackedCol, _trackedRow > lines ? _trackedRow - lines : 1);
     }
     
     // Move cursor down
     void cursorDown(uint8_t lines = 1) {
+        if (lines == 0) return; // CSI 0 B would move by one
         char buf[15];
         sprintf(buf, "\033[%dB", lines);
         _sendAnsiCommand(buf);
+        _trackMove(_trackedCol, min(_trackedRow + lines, (int)_screenRows));
     }
     
     // Move cursor right
     void cursorRight(uint8_t cols = 1) {
+        if (cols == 0) return; // CSI 0 C would move by one
         char buf[15];
         sprintf(buf, "\033[%dC", cols);
         _sendAnsiCommand(buf);
+        _trackMove(min(_trackedCol + cols, (int)_screenCols), _trackedRow);
     }
     
     // Move cursor left
     void cursorLeft(uint8_t cols = 1) {
+        if (cols == 0) return; // CSI 0 D would move by one
         char buf[15];
         sprintf(buf, "\033[%dD", cols);
         _sendAnsiCommand(buf);
+        _trackMove(_trackedCol > cols ? _trackedCol - cols : 1, _trackedRow);
     }
     
     // Set cursor visibility
     void setCursorVisible(bool visible) {
+        if (_dedupEnabled && (_knownState & KNOWN_VISIBILITY) && visible == _cursorVisible) return;
         _cursorVisible = visible;
+        _knownState |= KNOWN_VISIBILITY;
         _sendAnsiCommand(visible ? "\033[?25h" : "\033[?25l");
     }
     
@@ -190,7 +403,9 @@ public:
     
     // Set foreground color
     void setTextColor(uint8_t fg) {
+        if (_dedupEnabled && (_knownState & KNOWN_FG) && fg == _currentFg) return;
         _currentFg = fg;
+        _knownState |= KNOWN_FG;
         char buf[15];
         sprintf(buf, "\033[%dm", fg);
         _sendAnsiCommand(buf);
@@ -198,7 +413,9 @@ public:
     
     // Set background color
     void setTextBackgroundColor(uint8_t bg) {
+        if (_dedupEnabled && (_knownState & KNOWN_BG) && bg == _currentBg) return;
         _currentBg = bg;
+        _knownState |= KNOWN_BG;
         char buf[15];
         sprintf(buf, "\033[%dm", bg);
         _sendAnsiCommand(buf);
@@ -206,16 +423,33 @@ public:
     
     // Set both colors
     void setTextColor(uint8_t fg, uint8_t bg) {
+        if (_dedupEnabled) {
+            bool fgSame = (_knownState & KNOWN_FG) && fg == _currentFg;
+            bool bgSame = (_knownState & KNOWN_BG) && bg == _currentBg;
+            if (fgSame) { setTextBackgroundColor(bg); return; }
+            if (bgSame) { setTextColor(fg); return; }
+        }
         char buf[20];
         sprintf(buf, "\033[%d;%dm", fg, bg);
         _sendAnsiCommand(buf);
         _currentFg = fg;
         _currentBg = bg;
+        _knownState |= KNOWN_FG | KNOWN_BG;
     }
     
     // Set text attribute
     void setTextAttribute(uint8_t attr) {
+        if (_dedupEnabled && attr == qANSI_Attributes::RESET) {
+            resetAttributes(); // SGR 0 also resets the colors
+            return;
+        }
+        uint8_t bits = _attrBitsAfter(attr);
+        if (_dedupEnabled && (_knownState & KNOWN_ATTR) && bits == _attrBits) {
+            _currentAttr = attr;
+            return;
+        }
         _currentAttr = attr;
+        _attrBits = bits;
         char buf[15];
         sprintf(buf, "\033[%dm", attr);
         _sendAnsiCommand(buf);
@@ -223,20 +457,160 @@ public:
     
     // Reset all text attributes
     void resetAttributes() {
-        _sendAnsiCommand("\033[0m");
+        bool known = (_knownState & (KNOWN_FG | KNOWN_BG | KNOWN_ATTR)) == (KNOWN_FG | KNOWN_BG | KNOWN_ATTR);
+        bool atDefault = _currentFg == qANSI_Colors::FG_DEFAULT &&
+                         _currentBg == qANSI_Colors::BG_DEFAULT && _attrBits == 0;
         _currentAttr = qANSI_Attributes::RESET;
+        if (_dedupEnabled && known && atDefault) return;
+        _sendAnsiCommand("\033[0m");
         _currentFg = qANSI_Colors::FG_DEFAULT;
         _currentBg = qANSI_Colors::BG_DEFAULT;
+        _attrBits = 0;
+        _knownState |= KNOWN_FG | KNOWN_BG | KNOWN_ATTR;
     }
     
     // Save cursor position
     void saveCursor() {
         _sendAnsiCommand("\033[s");
+        _savedCol = _trackedCol;
+        _savedRow = _trackedRow;
+        if (_knownState & KNOWN_CURSOR) {
+            _knownState |= KNOWN_SAVED;
+        } else {
+            _knownState &= ~KNOWN_SAVED;
+        }
     }
     
     // Restore cursor position
     void restoreCursor() {
         _sendAnsiCommand("\033[u");
+        if (_knownState & KNOWN_SAVED) {
+            _trackCursor(_savedCol, _savedRow);
+        } else {
+            _knownState &= ~KNOWN_CURSOR;
+        }
+    }
+    
+    // --- Constant Sequences ---
+    
+    // Build a constant escape sequence at compile time, e.g.
+    // qANSI::seq<qANSI_Seq::Cup<10, 5>, qANSI_Seq::Fg<qANSI_Colors::FG_RED>, qANSI_Seq::Bold>()
+    template<class... Elements>
+    static qANSI_Sequence seq() {
+        typedef typename qANSI_Seq::Build<qANSI_Seq::Chars<>, qANSI_Seq::Chars<>, Elements...>::type Bytes;
+        typedef qANSI_Seq::Effects<Elements...> Fx;
+        qANSI_Sequence sequence = { Bytes::value, Bytes::size, Fx::flags, Fx::fg, Fx::bg,
+                                    Fx::attrOn, Fx::attrOff, Fx::col, Fx::row };
+        return sequence;
+    }
+    
+    // Send a pre-built sequence with a single write and update the tracked
+    // terminal state from its compile-time effects
+    size_t send(const qANSI_Sequence &sequence) {
+        size_t n = _writeProgmem(sequence.data, sequence.length);
+        
+        if (sequence.flags & qANSI_Sequence::RESET) {
+            _currentFg = qANSI_Colors::FG_DEFAULT;
+            _currentBg = qANSI_Colors::BG_DEFAULT;
+            _currentAttr = qANSI_Attributes::RESET;
+            _attrBits = 0;
+            _knownState |= KNOWN_FG | KNOWN_BG | KNOWN_ATTR;
+        }
+        if (sequence.fg) {
+            _currentFg = sequence.fg;
+            _knownState |= KNOWN_FG;
+        }
+        if (sequence.bg) {
+            _currentBg = sequence.bg;
+            _knownState |= KNOWN_BG;
+        }
+        _attrBits = (_attrBits | sequence.attrOn) & ~sequence.attrOff;
+        
+        if (sequence.flags & qANSI_Sequence::CURSOR_SET) {
+            _trackCursor(sequence.col, sequence.row);
+        } else if (sequence.flags & qANSI_Sequence::CURSOR_LOST) {
+            _knownState &= ~KNOWN_CURSOR;
+        }
+        if (sequence.flags & (qANSI_Sequence::CURSOR_SHOW | qANSI_Sequence::CURSOR_HIDE)) {
+            _cursorVisible = (sequence.flags & qANSI_Sequence::CURSOR_SHOW) != 0;
+            _knownState |= KNOWN_VISIBILITY;
+        }
+        return n;
+    }
+    
+    // Print a pipe-coded literal translated at compile time with QANSI_PIPE()
+    size_t print(const qANSI_PipeText &text) {
+        size_t n = _writeProgmem(text.ansi, text.ansiLength);
+        
+        // Keep the tracked state in step with what was sent
+        for (uint8_t i = 0; i < text.changeCount; i++) {
+            _applySgrState(_readStyleChange(text.changes, i).code);
+        }
+        if (_dedupEnabled) {
+            for (uint16_t i = 0; i < text.textLength; i++) {
+                _trackChar(pgm_read_byte(text.text + i));
+            }
+        }
+        return n;
+    }
+    
+    size_t println(const qANSI_PipeText &text) {
+        size_t n = print(text);
+        return n + println();
+    }
+
+    // Print a number with width, alignment, fill, sign and precision
+    // options (see qANSI_Format.h), formatted on the stack
+    size_t print(long value, const qANSI_NumberFormat &format) {
+        char buf[qANSI_Format::BUFFER_SIZE];
+        return write((const uint8_t *)buf, qANSI_Format::formatSigned(buf, value, format));
+    }
+
+    size_t print(unsigned long value, const qANSI_NumberFormat &format) {
+        char buf[qANSI_Format::BUFFER_SIZE];
+        return write((const uint8_t *)buf, qANSI_Format::formatUnsigned(buf, value, format));
+    }
+
+    size_t print(int value, const qANSI_NumberFormat &format) {
+        return print((long)value, format);
+    }
+
+    size_t print(unsigned int value, const qANSI_NumberFormat &format) {
+        return print((unsigned long)value, format);
+    }
+
+    size_t print(double value, const qANSI_NumberFormat &format) {
+        char buf[qANSI_Format::BUFFER_SIZE];
+        return write((const uint8_t *)buf, qANSI_Format::formatFloat(buf, value, format));
+    }
+    
+    // --- State Deduplication ---
+    
+    // When enabled, style changes that would not change the terminal are not
+    // sent, and setCursor() is turned into the cheapest relative move (or
+    // nothing) based on the cursor position tracked through printed characters,
+    // CR/LF/BS and cursor commands. State starts out unknown, so the first
+    // command of each kind is always sent.
+    void enableDeduplication(bool enable) {
+        _dedupEnabled = enable;
+        _knownState = 0;
+    }
+    
+    bool isDeduplicationEnabled() const {
+        return _dedupEnabled;
+    }
+    
+    // Physical screen size, needed to track autowrap and scrolling
+    void setScreenSize(uint8_t cols, uint8_t rows) {
+        _screenCols = cols;
+        _screenRows = rows;
+        _knownState &= ~KNOWN_CURSOR;
+    }
+    
+    // Forget the tracked terminal state, e.g. after output that bypassed this
+    // object. The next command of each kind will be sent unconditionally.
+    void invalidateTerminalState() {
+        _knownState = 0;
     }
     
     // --- Pipe Code Methods ---
@@ -254,11 +628,21 @@ public:
         return _pipeCodesEnabled;
     }
     
+    // Use a table of user-defined pipe codes (nullptr for built-in codes only).
+    // Swapping tables switches themes without touching the text.
+    void setPipeTable(const qANSI_PipeTable *table) {
+        _pipeTable = table;
+    }
+    
+    const qANSI_PipeTable *getPipeTable() const {
+        return _pipeTable;
+    }
+    
     // Implement Print's write method with pipe code handling
     virtual size_t write(uint8_t c) override {
         // If pipe codes are disabled, just pass through
         if (!_pipeCodesEnabled) {
-            return _output.write(c);
+            return _writeChar(c);
         }
         
         // Handle pipe codes
@@ -268,7 +652,7 @@ public:
                     _pipeSequenceState = 1;
                     return 1; // Count as written even though we're buffering
                 } else {
-                    return _output.write(c);
+                    return _writeChar(c);
                 }
                 break;
                 
@@ -283,17 +667,53 @@ public:
                 
             default:
                 _pipeSequenceState = 0;
-                return _output.write(c);
+                return _writeChar(c);
+        }
+    }
+    
+    // Bulk write with pipe code handling. Plain text between pipe codes is
+    // found with memchr() and sent with a single write; codes are decoded in
+    // place. A code split across calls is finished by the byte-wise state
+    // machine, so the result is the same as writing byte by byte.
+    virtual size_t write(const uint8_t *buffer, size_t size) override {
+        if (!_pipeCodesEnabled) {
+            return _writeSpan(buffer, size);
+        }
+        
+        size_t count = 0;
+        const uint8_t *end = buffer + size;
+        while (buffer < end) {
+            // Finish a code that was started earlier
+            if (_pipeSequenceState != 0) {
+                count += write(*buffer++);
+                continue;
+            }
+            
+            const uint8_t *pipe = (const uint8_t *)memchr(buffer, '|', end - buffer);
+            const uint8_t *spanEnd = pipe ? pipe : end;
+            if (spanEnd > buffer) {
+                count += _writeSpan(buffer, spanEnd - buffer);
+            }
+            buffer = spanEnd;
+            
+            if (pipe) {
+                if (end - pipe >= 3) {
+                    // Same count as the byte-wise path (1 per buffered byte)
+                    count += 2 + _processPipeCode(pipe[1], pipe[2]);
+                    buffer = pipe + 3;
+                } else {
+                    count += write(*buffer++); // Code continues in the next call
+                }
+            }
         }
+        return count;
     }
     
+    using Print::write;
+    
 // Write string, processing pipe codes
 size_t print(const char* str) {
-    size_t count = 0;
-    while (*str) {
-        count += write((uint8_t)*str++);
-    }
-    return count;
+    return write((const uint8_t *)str, strlen(str));
 }
 
 // Print just a line ending
@@ -330,80 +750,266 @@ protected:
     uint8_t _currentAttr;
     bool _cursorVisible;
     bool _pipeCodesEnabled;
+    const qANSI_PipeTable *_pipeTable;
     
     // Pipe code state machine
     uint8_t _pipeSequenceState;
     char _pipeChar1;
     
+    // Tracked terminal state for deduplication
+    enum {
+        KNOWN_FG = 0x01,
+        KNOWN_BG = 0x02,
+        KNOWN_ATTR = 0x04,
+        KNOWN_CURSOR = 0x08,
+        KNOWN_SAVED = 0x10,
+        KNOWN_VISIBILITY = 0x20
+    };
+    enum {
+        ATTR_BOLD = 0x01,
+        ATTR_UNDERLINE = 0x02,
+        ATTR_BLINK = 0x04,
+        ATTR_REVERSE = 0x08,
+        ATTR_CONCEALED = 0x10
+    };
+    bool _dedupEnabled;
+    uint8_t _knownState;  // KNOWN_* flags
+    uint8_t _attrBits;    // ATTR_* flags active on the terminal
+    uint8_t _trackedCol;  // Physical cursor position (1-based)
+    uint8_t _trackedRow;
+    uint8_t _savedCol;    // Position stored by saveCursor()
+    uint8_t _savedRow;
+    uint8_t _screenCols;
+    uint8_t _screenRows;
+    
+    // Write a character to the output, tracking its effect on the cursor
+    size_t _writeChar(uint8_t c) {
+        if (_dedupEnabled) _trackChar(c);
+        return _output.write(c);
+    }
+    
+    // Record the effect of an SGR code on the current style
+    void _applySgrState(uint8_t code) {
+        if (code == qANSI_Attributes::RESET) {
+            _currentFg = qANSI_Colors::FG_DEFAULT;
+            _currentBg = qANSI_Colors::BG_DEFAULT;
+            _currentAttr = qANSI_Attributes::RESET;
+            _attrBits = 0;
+            _knownState |= KNOWN_FG | KNOWN_BG | KNOWN_ATTR;
+        } else if ((code >= 30 && code <= 39) || (code >= 90 && code <= 97)) {
+            _currentFg = code;
+            _knownState |= KNOWN_FG;
+        } else if ((code >= 40 && code <= 49) || (code >= 100 && code <= 107)) {
+            _currentBg = code;
+            _knownState |= KNOWN_BG;
+        } else {
+            _currentAttr = code;
+            _attrBits = _attrBitsAfter(code);
+        }
+    }
+    
+    static qANSI_StyleChange _readStyleChange(const qANSI_StyleChange *changes, uint8_t i) {
+        qANSI_StyleChange change;
+        memcpy_P(&change, changes + i, sizeof(change));
+        return change;
+    }
+    
+    // Write bytes stored in flash (AVR) or regular memory with one write
+    size_t _writeProgmem(const char *data, size_t length) {
+#if defined(__AVR__)
+        size_t n = 0;
+        char buf[32];
+        while (length > 0) {
+            size_t chunk = min(length, sizeof(buf));
+            memcpy_P(buf, data, chunk);
+            n += _output.write((const uint8_t *)buf, chunk);
+            data += chunk;
+            length -= chunk;
+        }
+        return n;
+#else
+        return _output.write((const uint8_t *)data, length);
+#endif
+    }
+    
+    // Write a run of plain text to the output in one call
+    size_t _writeSpan(const uint8_t *buffer, size_t size) {
+        if (_dedupEnabled) {
+            for (size_t i = 0; i < size; i++) _trackChar(buffer[i]);
+        }
+        return _output.write(buffer, size);
+    }
+    
+    void _trackChar(uint8_t c) {
+        if (!(_knownState & KNOWN_CURSOR)) return;
+        
+        if (c == '\r') {
+            _trackedCol = 1;
+        } else if (c == '\n') {
+            if (_trackedRow < _screenRows) _trackedRow++; // Bottom row scrolls
+        } else if (c == '\b') {
+            if (_trackedCol > 1) _trackedCol--;
+        } else if (c >= 0x80) {
+            // One CP437 column or part of a UTF-8 character: the width is
+            // unknown, so the next move is sent in full
+            _knownState &= ~KNOWN_CURSOR;
+        } else if (c >= 32 && c != 127) {
+            if (_trackedCol >= _screenCols) {
+                _knownState &= ~KNOWN_CURSOR; // Pending autowrap differs between terminals
+            } else {
+                _trackedCol++;
+            }
+        } else if (c < 32) {
+            _knownState &= ~KNOWN_CURSOR; // Tab, ESC, ...
+        }
+    }
+    
+    void _trackCursor(uint8_t col, uint8_t row) {
+        _trackedCol = col;
+        _trackedRow = row;
+        _knownState |= KNOWN_CURSOR;
+    }
+    
+    // Relative moves only keep the position if it was known before
+    void _trackMove(uint8_t col, uint8_t row) {
+        if (_knownState & KNOWN_CURSOR) _trackCursor(col, row);
+    }
+    
+    // Attribute flags after sending an SGR attribute code
+    uint8_t _attrBitsAfter(uint8_t attr) const {
+        uint8_t bits = _attrBits;
+        switch (attr) {
+            case qANSI_Attributes::BOLD:          bits |= ATTR_BOLD; break;
+            case qANSI_Attributes::UNDERLINE:     bits |= ATTR_UNDERLINE; break;
+            case qANSI_Attributes::BLINK:         bits |= ATTR_BLINK; break;
+            case qANSI_Attributes::REVERSE:       bits |= ATTR_REVERSE; break;
+            case qANSI_Attributes::CONCEALED:     bits |= ATTR_CONCEALED; break;
+            case qANSI_Attributes::BOLD_OFF:      bits &= ~ATTR_BOLD; break;
+            case qANSI_Attributes::UNDERLINE_OFF: bits &= ~ATTR_UNDERLINE; break;
+            case qANSI_Attributes::BLINK_OFF:     bits &= ~ATTR_BLINK; break;
+            case qANSI_Attributes::REVERSE_OFF:   bits &= ~ATTR_REVERSE; break;
+            case qANSI_Attributes::CONCEALED_OFF: bits &= ~ATTR_CONCEALED; break;
+            default:                              bits = 0xFF; break; // Unknown: never deduplicated
+        }
+        return bits;
+    }
+    
+    static uint8_t _decimalDigits(uint8_t v) {
+        return v >= 100 ? 3 : (v >= 10 ? 2 : 1);
+    }
+    
+    // Length of a relative move "\033[nX" (parameter omitted for n == 1)
+    static uint8_t _moveCost(uint8_t n) {
+        return n == 0 ? 0 : (n == 1 ? 3 : 3 + _decimalDigits(n));
+    }
+    
+    // Cheapest horizontal move on the current row: CUF, CUB or backspaces
+    static uint8_t _horizontalCost(uint8_t from, uint8_t to) {
+        if (to > from) return _moveCost(to - from);
+        uint8_t n = from - to;
+        return min(n, _moveCost(n));
+    }
+    
+    static char *_appendMove(char *p, uint8_t n, char command) {
+        if (n == 0) return p;
+        if (n == 1) return p + sprintf(p, "\033[%c", command);
+        return p + sprintf(p, "\033[%d%c", n, command);
+    }
+    
+    static char *_appendHorizontal(char *p, uint8_t from, uint8_t to) {
+        if (to > from) return _appendMove(p, to - from, 'C');
+        uint8_t n = from - to;
+        if (n <= _moveCost(n)) {
+            while (n--) *p++ = '\b';
+            return p;
+        }
+        return _appendMove(p, n, 'D');
+    }
+    
+    // Move from the tracked position to (col, row) with the fewest bytes
+    void _moveCursorTo(uint8_t col, uint8_t row) {
+        if (col == _trackedCol && row == _trackedRow) return;
+        
+        uint8_t absoluteCost = (col == 1 && row == 1) ? 3 : 4 + _decimalDigits(row) + _decimalDigits(col);
+        uint8_t down = row > _trackedRow ? row - _trackedRow : 0;
+        uint8_t verticalCost = _moveCost(row > _trackedRow ? row - _trackedRow : _trackedRow - row);
+        uint8_t relativeCost = verticalCost + _horizontalCost(_trackedCol, col);
+        // After a CR, line feeds are safe even on terminals that add a CR to them
+        uint8_t returnVertical = down ? min(down, verticalCost) : verticalCost;
+        uint8_t returnCost = returnVertical + 1 + _horizontalCost(1, col);
+        
+        char buf[24];
+        char *p = buf;
+        if (absoluteCost <= relativeCost && absoluteCost <= returnCost) {
+            if (col == 1 && row == 1) {
+                p += sprintf(p, "\033[H");
+            } else {
+                p += sprintf(p, "\033[%d;%dH", row, col);
+            }
+        } else {
+            uint8_t from = _trackedCol;
+            if (returnCost < relativeCost) {
+                *p++ = '\r';
+                from = 1;
+            }
+            if (from == 1 && down && down <= verticalCost) {
+                while (down--) *p++ = '\n';
+            } else if (down) {
+                p = _appendMove(p, down, 'B');
+            }
+            if (row < _trackedRow) p = _appendMove(p, _trackedRow - row, 'A');
+            p = _appendHorizontal(p, from, col);
+        }
+        *p = '\0';
+        _sendAnsiCommand(buf);
+        _trackCursor(col, row);
+    }
+    
     // Helper to send raw ANSI command string
     void _sendAnsiCommand(const char* command) {
         _output.print(command);
     }
     
     // Process pipe code and return how many bytes were "written"
-// Process pipe code and return how many bytes were "written"
-size_t _processPipeCode(char c1, char c2) {
-    // Form the two-digit code
-    int code = (c1 - '0') * 10 + (c2 - '0');
-    
-    // Check for valid code range
-    if (c1 >= '0' && c1 <= '9' && c2 >= '0' && c2 <= '9') {
-        switch (code) {
-            // Foreground colors
-            case 0: setTextColor(qANSI_Colors::FG_BLACK); break;
-            case 1: setTextColor(qANSI_Colors::FG_BLUE); break;
-            case 2: setTextColor(qANSI_Colors::FG_GREEN); break;
-            case 3: setTextColor(qANSI_Colors::FG_CYAN); break;
-            case 4: setTextColor(qANSI_Colors::FG_RED); break;
-            case 5: setTextColor(qANSI_Colors::FG_MAGENTA); break;
-            case 6: setTextColor(qANSI_Colors::FG_YELLOW); break; // Brown in some terminals
-            case 7: setTextColor(qANSI_Colors::FG_WHITE); break;
-            
-            // Bright foreground colors
-            case 8: setTextColor(qANSI_Colors::FG_BRIGHT_BLACK); break; // Dark Grey
-            case 9: setTextColor(qANSI_Colors::FG_BRIGHT_BLUE); break;
-            case 10: setTextColor(qANSI_Colors::FG_BRIGHT_GREEN); break;
-            case 11: setTextColor(qANSI_Colors::FG_BRIGHT_CYAN); break;
-            case 12: setTextColor(qANSI_Colors::FG_BRIGHT_RED); break;
-            case 13: setTextColor(qANSI_Colors::FG_BRIGHT_MAGENTA); break;
-            case 14: setTextColor(qANSI_Colors::FG_BRIGHT_YELLOW); break;
-            case 15: setTextColor(qANSI_Colors::FG_BRIGHT_WHITE); break;
-            
-            // Background colors
-            case 16: setTextBackgroundColor(qANSI_Colors::BG_BLACK); break;
-            case 17: setTextBackgroundColor(qANSI_Colors::BG_BLUE); break;
-            case 18: setTextBackgroundColor(qANSI_Colors::BG_GREEN); break;
-            case 19: setTextBackgroundColor(qANSI_Colors::BG_CYAN); break;
-            case 20: setTextBackgroundColor(qANSI_Colors::BG_RED); break;
-            case 21: setTextBackgroundColor(qANSI_Colors::BG_MAGENTA); break;
-            case 22: setTextBackgroundColor(qANSI_Colors::BG_YELLOW); break; // Brown
-            case 23: setTextBackgroundColor(qANSI_Colors::BG_WHITE); break;
-            
-            // Special codes
-            case 24: resetAttributes(); break;
-            case 25: setTextAttribute(qANSI_Attributes::BOLD); break;
-            case 26: setTextAttribute(qANSI_Attributes::UNDERLINE); break;
-            case 27: setTextAttribute(qANSI_Attributes::BLINK); break;
-            case 28: setTextAttribute(qANSI_Attributes::REVERSE); break;
-            case 29: setTextAttribute(qANSI_Attributes::BOLD_OFF); break;
-            case 30: setTextAttribute(qANSI_Attributes::UNDERLINE_OFF); break;
-            case 31: setTextAttribute(qANSI_Attributes::BLINK_OFF); break;
-            case 32: setTextAttribute(qANSI_Attributes::REVERSE_OFF); break;
-            
-            default:
-                // Not a supported code, output the original sequence
-                _output.write('|');
-                _output.write(c1);
-                return _output.write(c2) + 2;
+    size_t _processPipeCode(char c1, char c2) {
+        // User-defined codes take precedence, so a table can also re-theme built-in codes
+        const qANSI_PipeTable::Entry *entry = _pipeTable ? _pipeTable->find(c1, c2) : nullptr;
+        if (entry) {
+            _output.write(_pipeTable->ansi(*entry), entry->ansiLength);
+            _applyPipeOps(_pipeTable->ops(*entry), entry->opsLength);
+            return 3;
+        }
+        
+        uint8_t sgr = qANSI_PipeTable::builtinSgr(c1, c2);
+        if (sgr == 0xFF) {
+            // Not a supported code, output the original sequence
+            _writeChar('|');
+            _writeChar(c1);
+            return _writeChar(c2) + 2;
+        }
+        
+        if (sgr == qANSI_Attributes::RESET) {
+            resetAttributes();
+        } else if ((sgr >= 30 && sgr <= 39) || (sgr >= 90 && sgr <= 97)) {
+            setTextColor(sgr);
+        } else if (sgr >= 40 && sgr <= 49) {
+            setTextBackgroundColor(sgr);
+        } else {
+            setTextAttribute(sgr);
         }
         return 3; // Pipe code handled (3 characters: |nn)
-    } else {
-        // Not a valid numeric code, output the original sequence
-        _output.write('|');
-        _output.write(c1);
-        return _output.write(c2) + 2;
     }
-}
+    
+    // Replay the effect of a pre-encoded pipe table expansion on the tracked state
+    void _applyPipeOps(const uint8_t *ops, uint8_t length) {
+        for (uint8_t i = 0; i < length; i++) {
+            if (ops[i] == qANSI_PipeTable::OP_STYLE && i + 1 < length) {
+                _applySgrState(ops[++i]);
+            } else if (_dedupEnabled) {
+                _trackChar(ops[i]);
+            }
+        }
+    }
 };
 
 #endif // Q_ANSI_H
@@ -0,0 +1,392 @@
+/*
+ * qANSI_Format.h - Allocation-free number formatting for qANSI
+ *
+ * Formats integers and floating point values into a caller-supplied
+ * buffer. Decimal integers are converted two digits at a time through a
+ * digit-pair table. Floats are split into integer and fraction parts with
+ * a single scaling step (no per-digit multiplies, no accumulated rounding
+ * error), in fixed-point mode or as the shortest decimal that reads back
+ * as the same float. Width, fill, alignment and sign options apply to
+ * both.
+ *
+ * QANSI_FORMAT() checks a printf-style format string at compile time and
+ * stores it in flash, for qANSI_VT::printf() and printAt().
+ *
+ * Usage:
+ *   vt.print(temperature, qANSI_NumberFormat(6, 1));          // "  21.5"
+ *   vt.print(count, qANSI_NumberFormat(5, 0, '0'));           // "00042"
+ *   vt.print(value, qANSI_NumberFormat(0, 0, ' ', qANSI_NumberFormat::LEFT,
+ *                                      qANSI_NumberFormat::SHORTEST));
+ *   vt.printf(QANSI_FORMAT("%-8s %6.1f C"), name, temperature);
+ *
+ * Included by qANSI.h.
+ *
+ * License: MIT License
+ */
+
+#ifndef Q_ANSI_FORMAT_H
+#define Q_ANSI_FORMAT_H
+
+// --- Field options for formatted numbers ---
+struct qANSI_NumberFormat {
+    enum { RIGHT, LEFT, CENTER };           // align
+    enum { PLUS = 0x01, SHORTEST = 0x02, LOWERCASE = 0x04 };  // flags
+
+    uint8_t width;      // Minimum field width (0 = as wide as the number)
+    uint8_t precision;  // Digits after the decimal point (floats, max 9)
+    char fill;          // '0' pads between the sign and the digits
+    uint8_t align;
+    uint8_t flags;      // PLUS: '+' on positive numbers; SHORTEST: shortest
+                        // float digits that round-trip (precision is ignored);
+                        // LOWERCASE: lowercase hex digits
+    uint8_t base;       // 2..16, integers only
+
+    explicit qANSI_NumberFormat(uint8_t width = 0, uint8_t precision = 2, char fill = ' ',
+                                uint8_t align = RIGHT, uint8_t flags = 0, uint8_t base = 10)
+        : width(width), precision(precision), fill(fill), align(align), flags(flags), base(base) {}
+};
+
+namespace qANSI_Format {
+
+    // Output buffer size for format*() (the field width is capped to fit);
+    // a 64-bit long in binary needs 64 digits
+    const uint8_t BUFFER_SIZE = sizeof(long) > 4 ? 80 : 48;
+
+    inline const char *digitPairs() {
+        static const char pairs[201] PROGMEM =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+        return pairs;
+    }
+
+    // Write the digits of value backwards, ending just before end.
+    // Returns the number of digits.
+    inline uint8_t writeDigits(char *end, unsigned long value, uint8_t base = 10, bool lowercase = false) {
+        char *p = end;
+        if (base == 10) {
+            const char *pairs = digitPairs();
+            while (value >= 100) {
+                uint8_t i = (uint8_t)(value % 100) * 2;
+                value /= 100;
+                *--p = pgm_read_byte(pairs + i + 1);
+                *--p = pgm_read_byte(pairs + i);
+            }
+            if (value >= 10) {
+                uint8_t i = (uint8_t)value * 2;
+                *--p = pgm_read_byte(pairs + i + 1);
+                *--p = pgm_read_byte(pairs + i);
+            } else {
+                *--p = '0' + (char)value;
+            }
+        } else {
+            if (base < 2 || base > 16) base = 10;
+            char letters = lowercase ? 'a' : 'A';
+            do {
+                uint8_t d = value % base;
+                *--p = d < 10 ? '0' + d : letters + d - 10;
+                value /= base;
+            } while (value);
+        }
+        return end - p;
+    }
+
+    inline uint8_t countDigits(unsigned long value, uint8_t base = 10) {
+        uint8_t n = 1;
+        if (base == 10 || base < 2 || base > 16) {
+            // Compare against powers of ten, no divisions; stop at the
+            // largest one that fits
+            for (unsigned long limit = 10; value >= limit; limit *= 10) {
+                n++;
+                if (limit > (unsigned long)-1 / 10) break;
+            }
+            return n;
+        }
+        while (value >= base) {
+            value /= base;
+            n++;
+        }
+        return n;
+    }
+
+    // Write the leading fill and sign of a field holding length characters
+    // (plus the sign). Returns where the characters go; trailing is set to
+    // the fill that follows them.
+    inline char *openField(char *out, uint8_t length, char sign,
+                           const qANSI_NumberFormat &format, uint8_t &trailing) {
+        uint8_t total = length + (sign ? 1 : 0);
+        uint8_t width = format.width < BUFFER_SIZE ? format.width : BUFFER_SIZE - 1;
+        uint8_t pad = width > total ? width - total : 0;
+        bool zeros = (format.fill == '0' && format.align == qANSI_NumberFormat::RIGHT);
+        uint8_t before = (format.align == qANSI_NumberFormat::RIGHT) ? pad :
+                         (format.align == qANSI_NumberFormat::CENTER) ? pad / 2 : 0;
+        trailing = pad - before;
+
+        // Plain loops: fields are short, library calls would cost more
+        if (!zeros) {
+            for (uint8_t i = 0; i < before; i++) *out++ = format.fill;
+        }
+        if (sign) *out++ = sign;
+        if (zeros) {
+            for (uint8_t i = 0; i < before; i++) *out++ = '0';
+        }
+        return out;
+    }
+
+    // Write the trailing fill and terminate. Returns the field length.
+    inline uint8_t closeField(char *out, char *end, uint8_t trailing, char fill) {
+        while (trailing--) *end++ = fill;
+        *end = 0;
+        return end - out;
+    }
+
+    // Field holding a literal string
+    inline uint8_t formatText(char *out, const char *text, char sign, const qANSI_NumberFormat &format) {
+        uint8_t length = strlen(text);
+        uint8_t trailing;
+        char *p = openField(out, length, sign, format, trailing);
+        memcpy(p, text, length);
+        return closeField(out, p + length, trailing, format.fill);
+    }
+
+    inline uint8_t formatMagnitude(char *out, unsigned long value, char sign, const qANSI_NumberFormat &format) {
+        uint8_t length = countDigits(value, format.base);
+        uint8_t trailing;
+        char *p = openField(out, length, sign, format, trailing);
+        writeDigits(p + length, value, format.base, (format.flags & qANSI_NumberFormat::LOWERCASE) != 0);
+        return closeField(out, p + length, trailing, format.fill);
+    }
+
+    // The format* functions write a terminated field to out (BUFFER_SIZE
+    // bytes) and return its length. Integers keep the full width of long.
+    inline uint8_t formatUnsigned(char *out, unsigned long value, const qANSI_NumberFormat &format) {
+        return formatMagnitude(out, value, (format.flags & qANSI_NumberFormat::PLUS) ? '+' : 0, format);
+    }
+
+    // Negative values get a '-' in base 10; other bases print the two's
+    // complement like Arduino's Print
+    inline uint8_t formatSigned(char *out, long value, const qANSI_NumberFormat &format) {
+        if (value >= 0 || format.base != 10) {
+            return formatUnsigned(out, (unsigned long)value, format);
+        }
+        return formatMagnitude(out, 0UL - (unsigned long)value, '-', format);
+    }
+
+    // Split a non-negative value into integer and rounded fraction digits
+    inline void splitFloat(double value, uint8_t precision, uint32_t &intPart, uint32_t &fraction) {
+        uint32_t scale = 1;
+        for (uint8_t i = 0; i < precision; i++) scale *= 10;
+        intPart = (uint32_t)value;
+        fraction = (uint32_t)((value - intPart) * scale + 0.5);
+        if (fraction >= scale) {
+            fraction -= scale;
+            intPart++;
+        }
+    }
+
+    // Fewest decimals (up to 9) that read back as the same float
+    inline uint8_t shortestPrecision(double value) {
+        float target = (float)value;
+        uint32_t scale = 1;
+        for (uint8_t precision = 0; precision < 9; precision++, scale *= 10) {
+            uint32_t intPart, fraction;
+            splitFloat(value, precision, intPart, fraction);
+            if ((float)(intPart + (double)fraction / scale) == target) return precision;
+        }
+        return 9;
+    }
+
+    // Values beyond 32 bits print as "ovf", like Arduino's Print
+    inline uint8_t formatFloat(char *out, double value, const qANSI_NumberFormat &format) {
+        char sign = (format.flags & qANSI_NumberFormat::PLUS) ? '+' : 0;
+        if (value != value) return formatText(out, "nan", 0, format);
+        if (value < 0) {
+            sign = '-';
+            value = -value;
+        }
+        if (value > 4294967040.0) {
+            return formatText(out, value > 3.4e38 ? "inf" : "ovf", sign, format);
+        }
+
+        uint8_t precision = (format.flags & qANSI_NumberFormat::SHORTEST) ? shortestPrecision(value) :
+                            (format.precision > 9 ? 9 : format.precision);
+        uint32_t intPart, fraction;
+        splitFloat(value, precision, intPart, fraction);
+
+        uint8_t intDigits = countDigits(intPart);
+        uint8_t length = intDigits + (precision ? precision + 1 : 0);
+        uint8_t trailing;
+        char *p = openField(out, length, sign, format, trailing);
+        writeDigits(p + intDigits, intPart);
+        if (precision) {
+            char *end = p + length;
+            uint8_t n = writeDigits(end, fraction);
+            while (n < precision) end[-++n] = '0';
+            p[intDigits] = '.';
+        }
+        return closeField(out, p + length, trailing, format.fill);
+    }
+
+    // --- printf-style format strings (QANSI_FORMAT) ---
+    // Specification: %[flags][width][.precision][length]conversion
+    //   flags:       '-' left, '^' center, '+' sign, '0' zero padding
+    //   length:      'l'/'h' are accepted and ignored (the argument type is known)
+    //   conversion:  d i u x X o b (binary) c s f F g (shortest), and %%
+
+    constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    constexpr bool isFlag(char c) { return c == '-' || c == '^' || c == '+' || c == '0'; }
+    constexpr bool isConversion(char c) {
+        return c == 'd' || c == 'i' || c == 'u' || c == 'x' || c == 'X' || c == 'o' || c == 'b' ||
+               c == 'c' || c == 's' || c == 'f' || c == 'F' || c == 'g';
+    }
+    constexpr bool takesPrecision(char c) { return c == 'f' || c == 'F' || c == 's'; }
+
+    constexpr const char *skipFlags(const char *s) { return isFlag(*s) ? skipFlags(s + 1) : s; }
+    constexpr const char *skipDigits(const char *s) { return isDigit(*s) ? skipDigits(s + 1) : s; }
+    constexpr const char *skipPrecision(const char *s) { return *s == '.' ? skipDigits(s + 1) : s; }
+    constexpr const char *skipLength(const char *s) { return (*s == 'l' || *s == 'h') ? skipLength(s + 1) : s; }
+
+    // The conversion character of a specification (s points after the '%')
+    constexpr const char *conversionOf(const char *s) {
+        return skipLength(skipPrecision(skipDigits(skipFlags(s))));
+    }
+
+    // w points to the end of the width (a '.' if there is a precision)
+    constexpr bool validPrecision(const char *w, char conversion) {
+        return *w != '.' || (takesPrecision(conversion) && skipDigits(w + 1) - (w + 1) <= 2);
+    }
+
+    // Conversion known, width and precision below 100
+    constexpr bool validSpec(const char *s) {
+        return isConversion(*conversionOf(s)) &&
+               skipDigits(skipFlags(s)) - skipFlags(s) <= 2 &&
+               validPrecision(skipDigits(skipFlags(s)), *conversionOf(s));
+    }
+
+    // Number of arguments a format string takes, or -1 if it is malformed
+    constexpr int countArgs(const char *s, int n = 0) {
+        return *s == 0 ? n :
+               *s != '%' ? countArgs(s + 1, n) :
+               s[1] == '%' ? countArgs(s + 2, n) :
+               !validSpec(s + 1) ? -1 :
+               countArgs(conversionOf(s + 1) + 1, n + 1);
+    }
+
+    // Conversion character for argument i (0 if there is none)
+    constexpr char conversionFor(const char *s, int i) {
+        return *s == 0 ? 0 :
+               *s != '%' ? conversionFor(s + 1, i) :
+               s[1] == '%' ? conversionFor(s + 2, i) :
+               i == 0 ? *conversionOf(s + 1) :
+               conversionFor(conversionOf(s + 1) + 1, i - 1);
+    }
+
+    // Argument types: the kind checked against the conversion and the type
+    // the value is passed on as
+    enum { ARG_NONE, ARG_SIGNED, ARG_UNSIGNED, ARG_REAL, ARG_CHAR, ARG_STRING, ARG_FLASH_STRING };
+    template<class T> struct Arg { static const uint8_t kind = ARG_NONE; typedef long type; };
+    template<> struct Arg<signed char> { static const uint8_t kind = ARG_SIGNED; typedef long type; };
+    template<> struct Arg<short> { static const uint8_t kind = ARG_SIGNED; typedef long type; };
+    template<> struct Arg<int> { static const uint8_t kind = ARG_SIGNED; typedef long type; };
+    template<> struct Arg<long> { static const uint8_t kind = ARG_SIGNED; typedef long type; };
+    template<> struct Arg<unsigned char> { static const uint8_t kind = ARG_UNSIGNED; typedef unsigned long type; };
+    template<> struct Arg<unsigned short> { static const uint8_t kind = ARG_UNSIGNED; typedef unsigned long type; };
+    template<> struct Arg<unsigned int> { static const uint8_t kind = ARG_UNSIGNED; typedef unsigned long type; };
+    template<> struct Arg<unsigned long> { static const uint8_t kind = ARG_UNSIGNED; typedef unsigned long type; };
+    template<> struct Arg<float> { static const uint8_t kind = ARG_REAL; typedef double type; };
+    template<> struct Arg<double> { static const uint8_t kind = ARG_REAL; typedef double type; };
+    template<> struct Arg<char> { static const uint8_t kind = ARG_CHAR; typedef char type; };
+    template<> struct Arg<const char *> { static const uint8_t kind = ARG_STRING; typedef const char *type; };
+    template<> struct Arg<char *> { static const uint8_t kind = ARG_STRING; typedef const char *type; };
+    template<size_t N> struct Arg<char[N]> { static const uint8_t kind = ARG_STRING; typedef const char *type; };
+    template<> struct Arg<const __FlashStringHelper *> {
+        static const uint8_t kind = ARG_FLASH_STRING;
+        typedef const __FlashStringHelper *type;
+    };
+
+    constexpr bool accepts(char conversion, uint8_t kind) {
+        return conversion == 's' ? (kind == ARG_STRING || kind == ARG_FLASH_STRING) :
+               conversion == 'c' ? (kind == ARG_CHAR || kind == ARG_SIGNED || kind == ARG_UNSIGNED) :
+               (conversion == 'f' || conversion == 'F' || conversion == 'g') ?
+                   (kind == ARG_REAL || kind == ARG_SIGNED || kind == ARG_UNSIGNED) :
+               (kind == ARG_SIGNED || kind == ARG_UNSIGNED || kind == ARG_CHAR);
+    }
+
+    // Check every argument against its conversion (I is the argument index)
+    template<class Literal, int I, class... Args> struct CheckArgs {
+        static const bool value = true;
+    };
+    template<class Literal, int I, class A, class... Args> struct CheckArgs<Literal, I, A, Args...> {
+        static_assert(Arg<A>::kind != ARG_NONE, "Unsupported argument type for a QANSI_FORMAT string");
+        static_assert(accepts(conversionFor(Literal::str(), I), Arg<A>::kind),
+                      "Argument type does not match its QANSI_FORMAT conversion");
+        static const bool value = CheckArgs<Literal, I + 1, Args...>::value;
+    };
+
+    // Read a specification at run time (p points after the '%', in PROGMEM
+    // on AVR; the string was checked at compile time). Returns the conversion
+    // character and leaves p after it.
+    inline char parseSpec(const char *&p, qANSI_NumberFormat &format) {
+        format = qANSI_NumberFormat(0, 0xFF);  // 0xFF: no precision given
+        char c;
+        while (isFlag(c = pgm_read_byte(p))) {
+            if (c == '-') format.align = qANSI_NumberFormat::LEFT;
+            else if (c == '^') format.align = qANSI_NumberFormat::CENTER;
+            else if (c == '+') format.flags |= qANSI_NumberFormat::PLUS;
+            else format.fill = '0';
+            p++;
+        }
+        if (format.align != qANSI_NumberFormat::RIGHT) format.fill = ' ';
+        for (format.width = 0; isDigit(c = pgm_read_byte(p)); p++) {
+            format.width = format.width * 10 + (c - '0');
+        }
+        if (c == '.') {
+            for (format.precision = 0; isDigit(c = pgm_read_byte(++p)); ) {
+                format.precision = format.precision * 10 + (c - '0');
+            }
+        }
+        while (c == 'l' || c == 'h') c = pgm_read_byte(++p);
+        p++;
+        if (format.precision == 0xFF && c != 's') format.precision = 6;  // As in C
+        switch (c) {
+            case 'x': format.flags |= qANSI_NumberFormat::LOWERCASE; format.base = 16; break;
+            case 'X': format.base = 16; break;
+            case 'o': format.base = 8; break;
+            case 'b': format.base = 2; break;
+            case 'g': format.flags |= qANSI_NumberFormat::SHORTEST; break;
+        }
+        return c;
+    }
+
+    // A QANSI_FORMAT literal copied to flash
+    template<class Literal, class Idx> struct FormatLiteral;
+    template<class Literal, unsigned... I> struct FormatLiteral<Literal, qANSI_Seq::Indices<I...> > {
+        typedef qANSI_Seq::Chars<Literal::str()[I]...> type;
+    };
+}
+
+// A format string checked at compile time, made with QANSI_FORMAT()
+template<class Literal> struct qANSI_FormatString {
+    const char *text;   // PROGMEM on AVR
+};
+
+namespace qANSI_Format {
+    template<class Literal, unsigned N>
+    qANSI_FormatString<Literal> formatString() {
+        qANSI_FormatString<Literal> result = {
+            FormatLiteral<Literal, typename qANSI_Seq::MakeIndices<N>::type>::type::value
+        };
+        return result;
+    }
+}
+
+// printf-style format string for qANSI_VT::printf()/printAt(). Malformed
+// specifications, the argument count and argument types are compile errors.
+#define QANSI_FORMAT(literal) \
+    ([]() { \
+        struct Literal { static constexpr const char *str() { return literal; } }; \
+        static_assert(qANSI_Format::countArgs(literal) >= 0, "Malformed specification in QANSI_FORMAT string"); \
+        return qANSI_Format::formatString<Literal, sizeof(literal) - 1>(); \
+    }())
+
+#endif // Q_ANSI_FORMAT_H
@@ -0,0 +1,219 @@
+/*
+ * qANSI_Recorder.h - Session recording for qANSI / qANSI_VT
+ *
+ * A Stream wrapper that passes everything through to the real output and
+ * writes a timestamped copy in asciicast v2 format to a log (an SD card
+ * file, a second serial port, ...). The recording plays back with
+ * asciinema, or with the replay tool in extras/host, which also
+ * summarizes frame sizes and latencies.
+ *
+ * Usage:
+ *   qANSI_Recorder recorder(Serial, logFile, 80, 24);
+ *   qANSI_VT vt(80, 24, 1, 1, recorder);
+ *   recorder.begin();
+ *   ...
+ *   vt.display();
+ *   recorder.markFrame(vt);   // Frame boundary with its statistics
+ *
+ * Bytes are grouped into one event until QANSI_RECORDER_GAP_US passes or
+ * the event buffer is full. Bytes read back from the stream are recorded
+ * as input events. Bytes >= 0x80 are stored as \u00XX escapes.
+ *
+ * License: MIT License
+ */
+
+#ifndef Q_ANSI_RECORDER_H
+#define Q_ANSI_RECORDER_H
+
+#include "qANSI_VT.h"
+
+// Output bytes buffered per event
+#ifndef QANSI_RECORDER_BUFFER
+#define QANSI_RECORDER_BUFFER 64
+#endif
+
+// Output that follows within this time is added to the same event
+#ifndef QANSI_RECORDER_GAP_US
+#define QANSI_RECORDER_GAP_US 1000
+#endif
+
+class qANSI_Recorder : public Stream {
+public:
+  qANSI_Recorder(Stream &output, Print &log, uint8_t width = 80, uint8_t height = 24)
+    : _output(output), _log(log), _width(width), _height(height),
+      _recording(false), _start(0), _eventTime(0), _pendingLength(0) {}
+
+  // Write the asciicast header and start the clock
+  void begin() {
+    _log.print("{\"version\": 2, \"width\": ");
+    _log.print(_width);
+    _log.print(", \"height\": ");
+    _log.print(_height);
+    _log.println(", \"env\": {\"TERM\": \"xterm-256color\"}}");
+    _start = micros();
+    _recording = true;
+  }
+
+  // Flush the pending event and stop recording (output still passes through)
+  void end() {
+    _flushEvent();
+    _recording = false;
+  }
+
+  bool isRecording() const {
+    return _recording;
+  }
+
+  // Add a marker event (asciinema shows these as chapter marks)
+  void marker(const char *label) {
+    if (!_recording) return;
+    _flushEvent();
+    _beginEvent(micros() - _start, 'm');
+    _writeJson((const uint8_t *)label, strlen(label));
+    _log.println("\"]");
+  }
+
+  // Marker for a display() boundary: "frame" followed by key=value pairs.
+  // With QANSI_ENABLE_STATS the frame statistics are included, otherwise
+  // only the bytes of the last display() call.
+  void markFrame(const qANSI_VT &vt) {
+    if (!_recording) return;
+    _flushEvent();
+    _beginEvent(micros() - _start, 'm');
+#if QANSI_ENABLE_STATS
+    static const char *const categories[] = { "text", "cursor", "sgr", "erase", "scroll", "control" };
+    const qANSI_FrameStats &stats = vt.getFrameStats();
+    _field("frame strategy", stats.strategy);
+    _field(" reason", stats.fullRedrawReason);
+    _field(" dirty", stats.dirtyCells);
+    _field(" cells", stats.cellsEmitted);
+    _field(" bytes", stats.totalBytes());
+    for (uint8_t i = 0; i < qANSI_FrameStats::CATEGORIES; i++) {
+      _log.print(' ');
+      _field(categories[i], stats.bytes[i]);
+    }
+    _field(" escapes", stats.escapes);
+    _field(" calls", stats.calls);
+    _field(" us", stats.micros);
+#else
+    _field("frame bytes", vt.getLastDisplayBytes());
+#endif
+    _log.println("\"]");
+  }
+
+  // --- Stream interface ---
+  virtual size_t write(uint8_t c) override {
+    size_t n = _output.write(c);
+    if (n) _record(&c, 1);
+    return n;
+  }
+
+  virtual size_t write(const uint8_t *buffer, size_t size) override {
+    size_t n = _output.write(buffer, size);
+    _record(buffer, n);
+    return n;
+  }
+  using Print::write;
+
+  virtual int availableForWrite() override {
+    return _output.availableForWrite();
+  }
+
+  virtual void flush() override {
+    _flushEvent();
+    _output.flush();
+  }
+
+  virtual int available() override {
+    return _output.available();
+  }
+
+  virtual int read() override {
+    int c = _output.read();
+    if (c >= 0 && _recording) {
+      uint8_t byte = (uint8_t)c;
+      _flushEvent();
+      _beginEvent(micros() - _start, 'i');
+      _writeJson(&byte, 1);
+      _log.println("\"]");
+    }
+    return c;
+  }
+
+  virtual int peek() override {
+    return _output.peek();
+  }
+
+private:
+  Stream &_output;
+  Print &_log;
+  uint8_t _width;
+  uint8_t _height;
+  bool _recording;
+  uint32_t _start;          // micros() at begin()
+  uint32_t _eventTime;      // Start of the pending event, relative to _start
+  uint8_t _pending[QANSI_RECORDER_BUFFER];
+  uint8_t _pendingLength;
+
+  void _record(const uint8_t *data, size_t length) {
+    if (!_recording) return;
+    uint32_t now = micros() - _start;
+    if (_pendingLength && now - _eventTime > QANSI_RECORDER_GAP_US) {
+      _flushEvent();
+    }
+    while (length) {
+      if (_pendingLength == 0) _eventTime = now;
+      size_t n = QANSI_RECORDER_BUFFER - _pendingLength;
+      if (n > length) n = length;
+      memcpy(_pending + _pendingLength, data, n);
+      _pendingLength += n;
+      data += n;
+      length -= n;
+      if (_pendingLength == QANSI_RECORDER_BUFFER) _flushEvent();
+    }
+  }
+
+  void _flushEvent() {
+    if (_pendingLength == 0) return;
+    _beginEvent(_eventTime, 'o');
+    _writeJson(_pending, _pendingLength);
+    _log.println("\"]");
+    _pendingLength = 0;
+  }
+
+  // "[seconds.micros, "type", "" up to the opening quote of the data
+  void _beginEvent(uint32_t time, char type) {
+    char buf[24];
+    sprintf(buf, "[%lu.%06lu, \"%c\", \"", (unsigned long)(time / 1000000UL),
+            (unsigned long)(time % 1000000UL), type);
+    _log.print(buf);
+  }
+
+  void _field(const char *name, uint32_t value) {
+    _log.print(name);
+    _log.print('=');
+    _log.print((unsigned long)value);
+  }
+
+  void _writeJson(const uint8_t *data, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < length; i++) {
+      uint8_t c = data[i];
+      if (c == '"' || c == '\\') {
+        _log.print('\\');
+        _log.print((char)c);
+      } else if (c == '\n') {
+        _log.print("\\n");
+      } else if (c == '\r') {
+        _log.print("\\r");
+      } else if (c < 0x20 || c >= 0x7F) {
+        char buf[7] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F], 0 };
+        _log.print(buf);
+      } else {
+        _log.print((char)c);
+      }
+    }
+  }
+};
+
+#endif // Q_ANSI_RECORDER_H
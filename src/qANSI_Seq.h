@@ -0,0 +1,350 @@
+/*
+ * qANSI_Seq.h - Compile-time ANSI sequence builder for qANSI
+ *
+ * Builds constant escape sequences (cursor targets, colors, attributes)
+ * as template instantiations, so the final bytes exist at compile time
+ * and are stored in flash on AVR. Consecutive SGR elements are merged
+ * into one sequence ("\033[1;31;44m").
+ *
+ * Usage:
+ *   using namespace qANSI_Seq;
+ *   terminal.send(qANSI::seq<Cup<10, 5>, Fg<qANSI_Colors::FG_RED>, Bold>());
+ *
+ * Pipe-coded string literals can be translated the same way:
+ *   terminal.print(QANSI_PIPE("|04Red |02Green|RA"));
+ *
+ * Included by qANSI.h; requires C++11.
+ *
+ * License: MIT License
+ */
+
+#ifndef Q_ANSI_SEQ_H
+#define Q_ANSI_SEQ_H
+
+// --- A built sequence: bytes plus its effect on the terminal state ---
+struct qANSI_Sequence {
+    const char *data;      // Sequence bytes (PROGMEM on AVR)
+    uint16_t length;
+
+    // Effects, applied to the tracked state when the sequence is sent
+    uint8_t flags;         // qANSI_Sequence::* flags below
+    uint8_t fg;            // 0 = unchanged
+    uint8_t bg;            // 0 = unchanged
+    uint8_t attrOn;        // Attribute bits switched on
+    uint8_t attrOff;       // Attribute bits switched off
+    uint8_t col;           // Cursor target if CURSOR_SET
+    uint8_t row;
+
+    enum {
+        RESET = 0x01,          // SGR 0: colors and attributes back to default
+        CURSOR_SET = 0x02,     // Ends at (col, row)
+        CURSOR_LOST = 0x04,    // Ends at a position relative to the start
+        CURSOR_SHOW = 0x08,
+        CURSOR_HIDE = 0x10,
+        CLEAR_SCREEN = 0x20
+    };
+};
+
+// --- A translated pipe-coded literal ---
+// Style change to apply before text[offset] (an SGR code)
+struct qANSI_StyleChange {
+    uint16_t offset;
+    uint8_t code;
+};
+
+struct qANSI_PipeText {
+    const char *ansi;      // Final ANSI bytes (PROGMEM on AVR)
+    uint16_t ansiLength;
+    const char *text;      // Plain text without codes (PROGMEM on AVR)
+    uint16_t textLength;
+    const qANSI_StyleChange *changes; // Style changes in text order (PROGMEM on AVR)
+    uint8_t changeCount;
+};
+
+namespace qANSI_Seq {
+    // --- Character packs ---
+    template<char... C> struct Chars {
+        static const char value[sizeof...(C) + 1] PROGMEM;
+        static const uint16_t size = sizeof...(C);
+    };
+    template<char... C> const char Chars<C...>::value[sizeof...(C) + 1] PROGMEM = { C..., '\0' };
+
+    template<class A, class B> struct Concat;
+    template<char... A, char... B> struct Concat<Chars<A...>, Chars<B...> > {
+        typedef Chars<A..., B...> type;
+    };
+
+    // Decimal representation of N
+    template<unsigned N, bool Last = (N < 10)> struct Digits {
+        typedef typename Concat<typename Digits<N / 10>::type, Chars<(char)('0' + N % 10)> >::type type;
+    };
+    template<unsigned N> struct Digits<N, true> {
+        typedef Chars<(char)('0' + N)> type;
+    };
+
+    // Attribute code to qANSI attribute bit (matches qANSI::ATTR_*)
+    constexpr uint8_t attrBit(uint8_t code) {
+        return (code == 1 || code == 22) ? 0x01 :
+               (code == 4 || code == 24) ? 0x02 :
+               (code == 5 || code == 25) ? 0x04 :
+               (code == 7 || code == 27) ? 0x08 :
+               (code == 8 || code == 28) ? 0x10 : 0;
+    }
+
+    // --- Elements ---
+    // Every element describes its bytes (or SGR parameter) and its effect.
+    struct Element {
+        static const bool isSgr = false;
+        static const uint8_t flags = 0;
+        static const uint8_t fg = 0;
+        static const uint8_t bg = 0;
+        static const uint8_t attrOn = 0;
+        static const uint8_t attrOff = 0;
+        static const uint8_t col = 0;
+        static const uint8_t row = 0;
+    };
+
+    // Absolute cursor position (1-based)
+    template<uint8_t Col, uint8_t Row> struct Cup : Element {
+        static_assert(Col >= 1 && Row >= 1, "Cup coordinates are 1-based");
+        typedef typename Concat<Chars<'\033', '['>,
+                typename Concat<typename Digits<Row>::type,
+                typename Concat<Chars<';'>,
+                typename Concat<typename Digits<Col>::type, Chars<'H'> >::type>::type>::type>::type chars;
+        static const uint8_t flags = qANSI_Sequence::CURSOR_SET;
+        static const uint8_t col = Col;
+        static const uint8_t row = Row;
+    };
+
+    // Relative cursor movement
+    template<uint8_t N, char Command> struct Move : Element {
+        typedef typename Concat<Chars<'\033', '['>,
+                typename Concat<typename Digits<N>::type, Chars<Command> >::type>::type chars;
+        static const uint8_t flags = qANSI_Sequence::CURSOR_LOST;
+    };
+    template<uint8_t N = 1> struct Up : Move<N, 'A'> {};
+    template<uint8_t N = 1> struct Down : Move<N, 'B'> {};
+    template<uint8_t N = 1> struct Right : Move<N, 'C'> {};
+    template<uint8_t N = 1> struct Left : Move<N, 'D'> {};
+
+    // Foreground color (qANSI_Colors::FG_*)
+    template<uint8_t Code> struct Fg : Element {
+        static_assert((Code >= 30 && Code <= 39) || (Code >= 90 && Code <= 97), "Not a foreground color");
+        static const bool isSgr = true;
+        typedef typename Digits<Code>::type chars;
+        static const uint8_t fg = Code;
+    };
+
+    // Background color (qANSI_Colors::BG_*)
+    template<uint8_t Code> struct Bg : Element {
+        static_assert((Code >= 40 && Code <= 49) || (Code >= 100 && Code <= 107), "Not a background color");
+        static const bool isSgr = true;
+        typedef typename Digits<Code>::type chars;
+        static const uint8_t bg = Code;
+    };
+
+    // Text attribute (qANSI_Attributes::*)
+    template<uint8_t Code> struct Attr : Element {
+        static_assert(Code == 0 || attrBit(Code) != 0, "Not a supported attribute");
+        static const bool isSgr = true;
+        typedef typename Digits<Code>::type chars;
+        static const uint8_t flags = (Code == 0) ? (uint8_t)qANSI_Sequence::RESET : 0;
+        static const uint8_t attrOn = (Code != 0 && Code < 20) ? attrBit(Code) : 0;
+        static const uint8_t attrOff = (Code >= 20) ? attrBit(Code) : 0;
+    };
+    typedef Attr<0> Reset;
+    typedef Attr<1> Bold;
+    typedef Attr<4> Underline;
+    typedef Attr<5> Blink;
+    typedef Attr<7> Reverse;
+
+    // Raw sequences
+    template<class C, uint8_t Flags = 0> struct Raw : Element {
+        typedef C chars;
+        static const uint8_t flags = Flags;
+    };
+    typedef Raw<Chars<'\033', '[', '2', 'J'>, qANSI_Sequence::CLEAR_SCREEN> ClearScreen;
+    typedef Raw<Chars<'\033', '[', '0', 'J'> > ClearToEndOfScreen;
+    typedef Raw<Chars<'\033', '[', '0', 'K'> > ClearToEndOfLine;
+    typedef Raw<Chars<'\033', '[', '?', '2', '5', 'h'>, qANSI_Sequence::CURSOR_SHOW> ShowCursor;
+    typedef Raw<Chars<'\033', '[', '?', '2', '5', 'l'>, qANSI_Sequence::CURSOR_HIDE> HideCursor;
+
+    // --- Builder ---
+    // Pending SGR parameters are merged until a non-SGR element or the end
+    template<class Params> struct FlushSgr {
+        typedef typename Concat<Chars<'\033', '['>, typename Concat<Params, Chars<'m'> >::type>::type type;
+    };
+    template<> struct FlushSgr<Chars<> > {
+        typedef Chars<> type;
+    };
+
+    template<class Params, class P> struct AddParam {
+        typedef typename Concat<Params, typename Concat<Chars<';'>, P>::type>::type type;
+    };
+    template<class P> struct AddParam<Chars<>, P> {
+        typedef P type;
+    };
+
+    template<class Out, class Params, class E, bool Sgr = E::isSgr> struct Step {
+        typedef Out out;
+        typedef typename AddParam<Params, typename E::chars>::type params;
+    };
+    template<class Out, class Params, class E> struct Step<Out, Params, E, false> {
+        typedef typename Concat<Out, typename Concat<typename FlushSgr<Params>::type,
+                                                     typename E::chars>::type>::type out;
+        typedef Chars<> params;
+    };
+
+    template<class Out, class Params, class... Es> struct Build {
+        typedef typename Concat<Out, typename FlushSgr<Params>::type>::type type;
+    };
+    template<class Out, class Params, class E, class... Es> struct Build<Out, Params, E, Es...> {
+        typedef Step<Out, Params, E> S;
+        typedef typename Build<typename S::out, typename S::params, Es...>::type type;
+    };
+
+    // --- Pipe codes ---
+    // BBS color order (black, blue, green, cyan, red, ...) to ANSI order
+    constexpr uint8_t bbsToAnsi(uint8_t i) {
+        return ((i & 1) << 2) | (i & 2) | ((i & 4) >> 2);
+    }
+
+    // SGR code for a numeric pipe code |00..|32, or 0xFF if unsupported
+    constexpr uint8_t pipeNumericSgr(uint8_t code) {
+        return code < 8  ? 30 + bbsToAnsi(code) :
+               code < 16 ? 90 + bbsToAnsi(code - 8) :
+               code < 24 ? 40 + bbsToAnsi(code - 16) :
+               code == 24 ? 0 : code == 25 ? 1 : code == 26 ? 4 : code == 27 ? 5 : code == 28 ? 7 :
+               code == 29 ? 22 : code == 30 ? 24 : code == 31 ? 25 : code == 32 ? 27 : 0xFF;
+    }
+
+    // SGR code for a letter pipe code (qANSI_PipeCodes), or 0xFF if unsupported
+    constexpr uint8_t pipeLetterSgr(char a, char b) {
+        return (a == 'R' && b == 'A') ? 0 :
+               (b != '0' && b != '1') ? 0xFF :
+               a == 'B' ? (b == '1' ? 1 : 22) :
+               a == 'U' ? (b == '1' ? 4 : 24) :
+               a == 'F' ? (b == '1' ? 5 : 25) :
+               a == 'R' ? (b == '1' ? 7 : 27) : 0xFF;
+    }
+
+    constexpr uint8_t pipeCodeSgr(char a, char b) {
+        return (a >= '0' && a <= '9' && b >= '0' && b <= '9')
+                   ? pipeNumericSgr((a - '0') * 10 + (b - '0'))
+                   : pipeLetterSgr(a, b);
+    }
+
+    // --- Pipe literal translation ---
+    template<uint16_t Offset, uint8_t Code> struct Change {};
+    template<class... Cs> struct Changes {
+        static const uint8_t count = sizeof...(Cs);
+    };
+
+    template<class Cs, uint16_t Offset, uint8_t Code> struct AddChange;
+    template<class... Cs, uint16_t Offset, uint8_t Code> struct AddChange<Changes<Cs...>, Offset, Code> {
+        typedef Changes<Cs..., Change<Offset, Code> > type;
+    };
+
+    template<class Cs> struct ChangeTable;
+    template<uint16_t... O, uint8_t... C> struct ChangeTable<Changes<Change<O, C>...> > {
+        static const qANSI_StyleChange value[sizeof...(O) + 1] PROGMEM;
+    };
+    template<uint16_t... O, uint8_t... C>
+    const qANSI_StyleChange ChangeTable<Changes<Change<O, C>...> >::value[sizeof...(O) + 1] PROGMEM = {
+        { O, C }..., { 0xFFFF, 0 }
+    };
+
+    // Walks the literal: codes become merged SGR bytes plus a style change,
+    // other characters are copied to both the ANSI and the plain text
+    template<class Ansi, class Params, class Text, class Cs, char... S> struct PipeTranslate {
+        typedef typename Concat<Ansi, typename FlushSgr<Params>::type>::type ansi;
+        typedef Text text;
+        typedef Cs changes;
+    };
+    template<class Ansi, class Params, class Text, class Cs, char C, char... S>
+    struct PipeTranslate<Ansi, Params, Text, Cs, C, S...> {
+        typedef PipeTranslate<typename Concat<Ansi, typename Concat<typename FlushSgr<Params>::type, Chars<C> >::type>::type,
+                              Chars<>, typename Concat<Text, Chars<C> >::type, Cs, S...> Next;
+        typedef typename Next::ansi ansi;
+        typedef typename Next::text text;
+        typedef typename Next::changes changes;
+    };
+    template<class Ansi, class Params, class Text, class Cs, char A, char B, char... S>
+    struct PipeTranslate<Ansi, Params, Text, Cs, '|', A, B, S...> {
+        static const uint8_t code = pipeCodeSgr(A, B);
+        static_assert(code != 0xFF, "Unsupported pipe code in QANSI_PIPE literal");
+        typedef PipeTranslate<Ansi, typename AddParam<Params, typename Digits<code>::type>::type,
+                              Text, typename AddChange<Cs, Text::size, code>::type, S...> Next;
+        typedef typename Next::ansi ansi;
+        typedef typename Next::text text;
+        typedef typename Next::changes changes;
+    };
+    template<class Ansi, class Params, class Text, class Cs, char A>
+    struct PipeTranslate<Ansi, Params, Text, Cs, '|', A> {
+        static_assert(A != A, "Incomplete pipe code at the end of a QANSI_PIPE literal");
+    };
+    template<class Ansi, class Params, class Text, class Cs>
+    struct PipeTranslate<Ansi, Params, Text, Cs, '|'> {
+        static_assert(sizeof(Ansi) == 0, "Incomplete pipe code at the end of a QANSI_PIPE literal");
+    };
+
+    template<unsigned... I> struct Indices {};
+    template<unsigned N, unsigned... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+    template<unsigned... I> struct MakeIndices<0, I...> {
+        typedef Indices<I...> type;
+    };
+
+    template<class Literal, class Idx> struct PipeLiteral;
+    template<class Literal, unsigned... I> struct PipeLiteral<Literal, Indices<I...> > {
+        typedef PipeTranslate<Chars<>, Chars<>, Chars<>, Changes<>, Literal::str()[I]...> type;
+    };
+
+    template<class Literal, unsigned N>
+    qANSI_PipeText translatePipe() {
+        typedef typename PipeLiteral<Literal, typename MakeIndices<N>::type>::type T;
+        typedef typename T::ansi Ansi;
+        typedef typename T::text Text;
+        typedef typename T::changes Cs;
+        qANSI_PipeText result = { Ansi::value, Ansi::size, Text::value, Text::size,
+                                  ChangeTable<Cs>::value, Cs::count };
+        return result;
+    }
+
+    // Combined effect; later elements override earlier ones
+    template<class... Es> struct Effects {
+        static const uint8_t flags = 0;
+        static const uint8_t fg = 0;
+        static const uint8_t bg = 0;
+        static const uint8_t attrOn = 0;
+        static const uint8_t attrOff = 0;
+        static const uint8_t col = 0;
+        static const uint8_t row = 0;
+    };
+    template<class E, class... Es> struct Effects<E, Es...> {
+        typedef Effects<Es...> R;
+        static const bool laterReset = (R::flags & qANSI_Sequence::RESET) != 0;
+        static const uint8_t cursorMask = qANSI_Sequence::CURSOR_SET | qANSI_Sequence::CURSOR_LOST;
+        static const uint8_t visibilityMask = qANSI_Sequence::CURSOR_SHOW | qANSI_Sequence::CURSOR_HIDE;
+        static const bool laterCursor = (R::flags & cursorMask) != 0;
+
+        static const uint8_t flags = (R::flags & ~visibilityMask & ~cursorMask) | (E::flags & ~visibilityMask & ~cursorMask) |
+                                     (laterCursor ? (R::flags & cursorMask) : (E::flags & cursorMask)) |
+                                     ((R::flags & visibilityMask) ? (R::flags & visibilityMask) : (E::flags & visibilityMask));
+        static const uint8_t fg = R::fg ? R::fg : (laterReset ? 0 : E::fg);
+        static const uint8_t bg = R::bg ? R::bg : (laterReset ? 0 : E::bg);
+        static const uint8_t attrOn = laterReset ? R::attrOn : (R::attrOn | (E::attrOn & ~R::attrOff));
+        static const uint8_t attrOff = laterReset ? R::attrOff : (R::attrOff | (E::attrOff & ~R::attrOn));
+        static const uint8_t col = laterCursor ? R::col : E::col;
+        static const uint8_t row = laterCursor ? R::row : E::row;
+    };
+}
+
+// Translate a pipe-coded string literal at compile time. Unsupported or
+// incomplete codes are compile errors.
+#define QANSI_PIPE(literal) \
+    ([]() { \
+        struct Literal { static constexpr const char *str() { return literal; } }; \
+        return qANSI_Seq::translatePipe<Literal, sizeof(literal) - 1>(); \
+    }())
+
+#endif // Q_ANSI_SEQ_H
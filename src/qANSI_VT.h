@@ -20,6 +20,10 @@
 
 #include "qANSI.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // --- Structure to hold cell data ---
 struct AnsiCell {
   char character;
@@ -29,34 +33,245 @@ struct AnsiCell {
   bool dirty;      // Only update changed cells since last display()
 };
 
+// --- Per-call output budget for display() ---
+// A zero field means "no limit". useTxBuffer additionally caps the byte budget
+// at the stream's availableForWrite(), so display() never blocks on a full TX
+// buffer (only useful on streams that implement availableForWrite()).
+struct qANSI_Budget {
+  uint16_t maxBytes;   // Maximum bytes to send per call
+  uint32_t maxMicros;  // Maximum time to spend per call
+  bool useTxBuffer;    // Stop when the stream's TX buffer is full
+
+  qANSI_Budget(uint16_t bytes = 0, uint32_t micros = 0, bool txBuffer = false)
+    : maxBytes(bytes), maxMicros(micros), useTxBuffer(txBuffer) {}
+};
+
+// --- Priority region support ---
+// Maximum number of priority regions per terminal (the table is only
+// allocated when the first region is added)
+#ifndef QANSI_MAX_REGIONS
+#define QANSI_MAX_REGIONS 4
+#endif
+
+// Update latency of a region, in milliseconds from the display() call that
+// first saw a change until the call that finished sending it
+struct qANSI_RegionStats {
+  uint32_t updates;       // Number of completed region updates
+  uint32_t lastLatency;
+  uint32_t maxLatency;
+  uint32_t totalLatency;  // Divide by updates for the average
+  uint32_t missedTargets; // Updates that took longer than maxStaleMs
+};
+
+struct qANSI_Region {
+  uint8_t col, row;       // Top-left cell (1-based)
+  uint8_t width, height;
+  uint8_t priority;       // Higher is sent first
+  uint16_t maxStaleMs;    // Promote once dirty this long (0 = never)
+  bool pending;           // Has changes that are not fully sent
+  uint32_t dirtySince;    // millis() when the pending change was first seen
+  qANSI_RegionStats stats;
+};
+
+// --- Bound data fields ---
+// Maximum number of fields per terminal (the table is only allocated when
+// the first field is added)
+#ifndef QANSI_MAX_FIELDS
+#define QANSI_MAX_FIELDS 16
+#endif
+
+// Value of a field (the unused bytes are kept zero so values compare with memcmp)
+union qANSI_FieldValue {
+  long l;
+  unsigned long ul;
+  double d;
+};
+
+struct qANSI_Field {
+  enum { SET, INT, UINT, LONG, ULONG, FLOAT, DOUBLE, LONG_FUNCTION, DOUBLE_FUNCTION }; // source
+  enum { SIGNED, UNSIGNED, REAL };                                                   // kind
+
+  uint8_t col, row;       // First cell (1-based)
+  uint8_t width;          // Cells, clipped to the terminal
+  uint8_t source;         // Where refreshFields() reads the value (SET = setField() only)
+  uint8_t kind;
+  uint8_t fg, bg, attr;   // Style when the field was added
+  bool valid;             // The cells show value
+  qANSI_NumberFormat format;
+  union {
+    const int *i;
+    const unsigned int *ui;
+    const long *l;
+    const unsigned long *ul;
+    const float *f;
+    const double *d;
+    long (*lf)();
+    double (*df)();
+  } from;
+  qANSI_FieldValue value; // Last value drawn
+};
+
+// --- Box styles for drawBox() ---
+// Six glyphs: top-left, top-right, bottom-left, bottom-right corner, then
+// the horizontal and the vertical line. SINGLE and DOUBLE are the CP437
+// line-drawing characters (BBS terminals such as SyncTERM, the Linux
+// console with a CP437 font).
+namespace qANSI_Box {
+  const char ASCII[]  = "++++-|";
+  const char SINGLE[] = "\xDA\xBF\xC0\xD9\xC4\xB3";
+  const char DOUBLE[] = "\xC9\xBB\xC8\xBC\xCD\xBA";
+}
+
+// --- Rectangles and sprites ---
+struct qANSI_Rect {
+  uint8_t col, row;       // Top-left cell (1-based)
+  uint8_t width, height;
+
+  qANSI_Rect(uint8_t col = 1, uint8_t row = 1, uint8_t width = 0, uint8_t height = 0)
+    : col(col), row(row), width(width), height(height) {}
+};
+
+// An overlay drawn into a qANSI_VT buffer. The cells it covers are kept in a
+// caller-provided backing store and put back when it moves or is hidden.
+// The image may change between showSprite() calls (animation) as long as
+// its transparent cells stay the same.
+struct qANSI_Sprite {
+  const AnsiCell *image;  // width * height cells, row by row (dirty is ignored)
+  AnsiCell *saved;        // Backing store, width * height cells
+  uint8_t width, height;
+  char transparent;       // Image cells with this character show what is below (0 = none)
+  uint8_t col, row;       // Position while shown
+  bool shown;
+
+  qANSI_Sprite(const AnsiCell *image, uint8_t width, uint8_t height, AnsiCell *saved,
+               char transparent = 0)
+    : image(image), saved(saved), width(width), height(height), transparent(transparent),
+      col(1), row(1), shown(false) {}
+};
+
+// --- Additional output streams ---
+// Maximum number of streams a terminal mirrors its display to besides its
+// own output (the table is only allocated when the first sink is added)
+#ifndef QANSI_MAX_SINKS
+#define QANSI_MAX_SINKS 4
+#endif
+
+// Called after display() sent a frame to a state sync sink (addSyncSink()).
+// The transport reports the frame back with acknowledgeSink() once the remote
+// end has it, or with dropSinkFrame() if it was lost.
+typedef void (*qANSI_SyncHook)(uint8_t sink, uint16_t frame, void *context);
+
+struct qANSI_Sink {
+  Stream *stream;
+  qANSI_Budget budget;    // Per display() call
+  uint8_t runModes;       // Sequences the terminal understands (qANSI_VT::RUN_*)
+  uint8_t *pending;       // Cells not sent yet, one bit per cell
+  uint8_t cursorCol;      // Cursor as last sent (0: hidden or not sent yet)
+  uint8_t cursorRow;
+  uint32_t bytes;         // Sent by the most recent display() call
+
+  // State sync only (nullptr for a plain sink)
+  AnsiCell *acked;        // Screen as the remote end acknowledged it
+  AnsiCell *sent;         // acked plus the cells of the frame in flight
+  qANSI_SyncHook hook;
+  void *context;
+  uint16_t frame;         // Number of the last frame sent
+  bool inFlight;          // frame is not acknowledged yet
+};
+
+// --- Rendering statistics ---
+// Define QANSI_ENABLE_STATS as 1 before including qANSI_VT.h (the same way
+// in every file) to collect per-frame statistics. Otherwise the counters and
+// getFrameStats()/getRenderTotals() are compiled out.
+#ifndef QANSI_ENABLE_STATS
+#define QANSI_ENABLE_STATS 0
+#endif
+
+#if QANSI_ENABLE_STATS
+#define QANSI_STAT(statement) statement
+#else
+#define QANSI_STAT(statement)
+#endif
+
+// Output of one frame (which may take several budget-limited display() calls)
+struct qANSI_FrameStats {
+  enum { NONE, FULL, SPARSE, ROWS };                  // strategy
+  enum { NOT_FULL, FORCED, SCROLL, THRESHOLD };       // fullRedrawReason
+  enum { TEXT, CURSOR, SGR, ERASE, SCROLLING, CONTROL, CATEGORIES }; // bytes[]
+
+  uint8_t strategy;
+  uint8_t fullRedrawReason; // FORCED: begin(), setPosition(), forceFullRedraw()
+  uint16_t dirtyCells;      // Changed cells (all cells for a forced redraw)
+  uint16_t cellsEmitted;    // Cells actually sent
+  uint32_t bytes[CATEGORIES]; // CONTROL: cursor visibility
+  uint16_t escapes;         // Escape sequences sent
+  uint8_t calls;            // display() calls the frame took
+  uint32_t micros;          // Time spent inside display()
+
+  uint32_t totalBytes() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < CATEGORIES; i++) total += bytes[i];
+    return total;
+  }
+};
+
+// Running totals over all completed frames
+struct qANSI_RenderTotals {
+  uint32_t frames;
+  uint32_t fullRedraws[4];  // Indexed by qANSI_FrameStats::fullRedrawReason
+  uint32_t dirtyCells;
+  uint32_t cellsEmitted;
+  uint32_t bytes[qANSI_FrameStats::CATEGORIES];
+  uint32_t escapes;
+  uint32_t micros;
+};
+
+// --- Incoming escape sequence parser ---
+// Maximum number of CSI parameters kept per sequence (extra ones are ignored)
+#ifndef QANSI_ANSI_MAX_PARAMS
+#define QANSI_ANSI_MAX_PARAMS 8
+#endif
+
 class qANSI_VT : public qANSI {
 public:
   // --- Constructor ---
   qANSI_VT(uint8_t width, uint8_t height, uint8_t posX = 1, uint8_t posY = 1, Stream &output = Serial)
     : qANSI(output), _width(width), _height(height), _posX(posX), _posY(posY),
-      _buffer(nullptr),
+      _buffer(nullptr), _front(nullptr), _rowEpoch(nullptr), _clearEpoch(1),
+      _clearFg(qANSI_Colors::FG_DEFAULT), _clearBg(qANSI_Colors::BG_DEFAULT),
+      _clearAttr(qANSI_Attributes::RESET),
       _cursorX(1), _cursorY(1), // Internal buffer cursor
       _terminalCursorX(0), _terminalCursorY(0), // Tracked terminal state
       _terminalStateKnown(false), _scrollEnabled(true), _lineWrappingEnabled(true), 
-      _forceFullRedraw(true)
+      _forceFullRedraw(true),
+      _ansiParsingEnabled(true), _ansiState(ANSI_GROUND), _ansiParamCount(0),
+      _ansiSubParams(0), _ansiPrivate(0), _ansiIntermediate(0), _ansiSavedX(1), _ansiSavedY(1),
+      _regions(nullptr), _regionCount(0), _priority(0), _priorityMaxStaleMs(0), _pendingSince(0),
+      _fields(nullptr), _fieldCount(0), _runModes(RUN_ERASE),
+      _sinks(nullptr), _sinkCount(0), _sinkPending(nullptr), _sinkSent(nullptr), _target(&output),
+      _frameActive(false), _frameStrategy(FRAME_FULL), _frameRow(1), _frameCol(1),
+      _budgetBytes(0), _budgetLimit(0), _budgetReserve(0), _budgetStart(0), _budgetMicros(0)
   {
+    QANSI_STAT(resetRenderTotals());
+    QANSI_STAT(memset(&_lastFrameStats, 0, sizeof(_lastFrameStats)));
+    QANSI_STAT(_redrawReason = qANSI_FrameStats::FORCED);
+    
     if (_width > 0 && _height > 0) {
         // Allocate buffer
         size_t bufferSize = (size_t)_width * _height;
         _buffer = new AnsiCell[bufferSize];
-        if (!_buffer) {
+        _rowEpoch = new uint8_t[_height];
+        if (!_buffer || !_rowEpoch) {
             // Handle allocation failure
+            delete[] _buffer;
+            delete[] _rowEpoch;
+            _buffer = nullptr;
+            _rowEpoch = nullptr;
             _width = 0;
             _height = 0;
         } else {
-            // Initialize buffer with default values
-            for (size_t i = 0; i < bufferSize; i++) {
-                _buffer[i].character = ' ';
-                _buffer[i].fgColor = qANSI_Colors::FG_DEFAULT;
-                _buffer[i].bgColor = qANSI_Colors::BG_DEFAULT;
-                _buffer[i].attributes = qANSI_Attributes::RESET;
-                _buffer[i].dirty = true;
-            }
+            // Every row starts out cleared with the default style
+            memset(_rowEpoch, 0, _height);
         }
     } else {
         _width = 0; // Prevent zero-size allocation
@@ -67,6 +282,11 @@ public:
   // --- Destructor ---
   virtual ~qANSI_VT() {
     delete[] _buffer;
+    delete[] _front;
+    delete[] _rowEpoch;
+    delete[] _regions;
+    delete[] _fields;
+    clearSinks();
   }
 
   // --- Initialization ---
@@ -88,6 +308,7 @@ public:
     
     // Force a full redraw the first time
     _forceFullRedraw = true;
+    QANSI_STAT(_noteRedraw(qANSI_FrameStats::FORCED));
 
     clear(true); // Clear buffer and physical screen
   }
@@ -98,6 +319,7 @@ public:
     _posY = y;
     _terminalStateKnown = false; // Position change invalidates state
     _forceFullRedraw = true;     // Force full redraw after position change
+    QANSI_STAT(_noteRedraw(qANSI_FrameStats::FORCED));
   }
 
   // Add this method to retrieve the character at a specific cell
@@ -108,6 +330,16 @@ char getCharAt(uint8_t col, uint8_t row) {
   return _buffer[_getIndex(col, row)].character;
 }
 
+// Complete cell (character, colors, attribute); a blank cell if out of range
+AnsiCell getCellAt(uint8_t col, uint8_t row) const {
+  if (!_buffer || col < 1 || col > _width || row < 1 || row > _height) {
+    AnsiCell blank = { ' ', qANSI_Colors::FG_DEFAULT, qANSI_Colors::BG_DEFAULT,
+                       qANSI_Attributes::RESET, false };
+    return blank;
+  }
+  return _buffer[_getIndex(col, row)];
+}
+
   uint8_t getPositionX() const { return _posX; }
   uint8_t getPositionY() const { return _posY; }
 
@@ -120,36 +352,52 @@ char getCharAt(uint8_t col, uint8_t row) {
     return _lineWrappingEnabled;
   }
   
+  // --- Incoming Escape Sequences ---
+  // ANSI/VT100 output written to the terminal (e.g. captured from a library
+  // that already emits escape codes) is interpreted into the buffer instead
+  // of being stored as text: SGR colors and attributes, cursor movement,
+  // erase, insert/delete, scrolling, save/restore cursor, and the cursor
+  // visibility (?25) and auto-wrap (?7) modes. Other sequences, and OSC/DCS
+  // strings, are consumed and dropped.
+  void enableAnsiParsing(bool enable) {
+    _ansiParsingEnabled = enable;
+    _ansiState = ANSI_GROUND;
+  }
+  
+  bool isAnsiParsingEnabled() const {
+    return _ansiParsingEnabled;
+  }
+  
   // --- Force Full Redraw ---
+  // Constant time: the next display() starts a full frame and marks the
+  // cells as it goes
   void forceFullRedraw() {
     _forceFullRedraw = true;
-    
-    // Mark all cells as dirty
-    if (_buffer) {
-      size_t bufferSize = (size_t)_width * _height;
-      for (size_t i = 0; i < bufferSize; ++i) {
-        _buffer[i].dirty = true;
-      }
-    }
+    QANSI_STAT(_noteRedraw(qANSI_FrameStats::FORCED));
   }
 
   // --- Clear Screen ---
   void clear(bool clearPhysical = true) {
     if (!_buffer) return;
 
-    // Clear buffer with default values
-    size_t bufferSize = (size_t)_width * _height;
-    for (size_t i = 0; i < bufferSize; ++i) {
-      _buffer[i].character = ' ';
-      _buffer[i].fgColor = getCurrentFgColor();
-      _buffer[i].bgColor = getCurrentBgColor();
-      _buffer[i].attributes = getCurrentAttribute();
-      _buffer[i].dirty = true;
+    // Constant time: the fill style is recorded and every row becomes stale,
+    // a row is filled when it is first touched (see _getIndex())
+    _clearFg = getCurrentFgColor();
+    _clearBg = getCurrentBgColor();
+    _clearAttr = getCurrentAttribute();
+    if (++_clearEpoch == 0) {
+      // Rows last resolved 255 clears ago would look current again
+      memset(_rowEpoch, 0, _height);
+      _clearEpoch = 1;
     }
     
     setCursor(1, 1); // Reset internal buffer cursor
+    invalidateFields(); // Fields are drawn again by the next refreshFields()
 
     if (clearPhysical) {
+      // Other writers may have moved the cursor since the last update
+      invalidateTerminalState();
+      
       // Reset attributes
       resetAttributes();
       
@@ -159,7 +407,7 @@ char getCharAt(uint8_t col, uint8_t row) {
         
         // Fill with spaces up to our width
         for (uint8_t x = 0; x < _width; x++) {
-          _output.write(' ');
+          _writeChar(' ');
         }
       }
       
@@ -173,6 +421,14 @@ char getCharAt(uint8_t col, uint8_t row) {
       _terminalFg = qANSI_Colors::FG_DEFAULT;
       _terminalBg = qANSI_Colors::BG_DEFAULT;
       _terminalStateKnown = true;
+
+      if (_front) {
+        // The area now shows blanks in the default style
+        AnsiCell blank = { ' ', qANSI_Colors::FG_DEFAULT, qANSI_Colors::BG_DEFAULT,
+                           qANSI_Attributes::RESET, false };
+        size_t cells = (size_t)_width * _height;
+        for (size_t i = 0; i < cells; i++) _front[i] = blank;
+      }
     }
   }
 
@@ -203,6 +459,23 @@ void setCursor(uint8_t col, uint8_t row) {
   _cursorX = constrain(col, 1, _width);
   _cursorY = constrain(row, 1, _height);
 }  
+
+  // --- Constant Sequences ---
+  // A qANSI::seq<>() sequence is applied to the buffer instead of the wire:
+  // its bytes go through the ANSI interpreter in order, so colors and
+  // attributes become the current drawing style, Cup and relative moves
+  // move the buffer cursor and the clears erase cells. The affected cells
+  // go out through display(). This happens even with ANSI parsing off.
+  size_t send(const qANSI_Sequence &sequence) {
+    if (!_buffer || _width == 0 || _height == 0) return 0;
+    
+    _ansiState = ANSI_GROUND;  // A sequence left unfinished by write() is dropped
+    for (uint16_t i = 0; i < sequence.length; i++) {
+      _ansiInput(pgm_read_byte(sequence.data + i));
+    }
+    return sequence.length;
+  }
+
   uint8_t getCursorX() const { return _cursorX; }
   uint8_t getCursorY() const { return _cursorY; }
 
@@ -224,33 +497,52 @@ void setCursor(uint8_t col, uint8_t row) {
     
     // Move content up
     for (uint8_t y = 1; y <= _height - lines; ++y) {
-      for (uint8_t x = 1; x <= _width; ++x) {
-        uint16_t destIndex = _getIndex(x, y);
-        uint16_t srcIndex = _getIndex(x, y + lines);
-        
+      AnsiCell *dest = &_buffer[_getIndex(1, y)];
+      const AnsiCell *src = &_buffer[_getIndex(1, y + lines)];
+      for (uint8_t x = 0; x < _width; ++x) {
         // Copy cell contents
-        _buffer[destIndex].character = _buffer[srcIndex].character;
-        _buffer[destIndex].fgColor = _buffer[srcIndex].fgColor;
-        _buffer[destIndex].bgColor = _buffer[srcIndex].bgColor;
-        _buffer[destIndex].attributes = _buffer[srcIndex].attributes;
-        _buffer[destIndex].dirty = true; // Mark as changed
+        dest[x].character = src[x].character;
+        dest[x].fgColor = src[x].fgColor;
+        dest[x].bgColor = src[x].bgColor;
+        dest[x].attributes = src[x].attributes;
+        dest[x].dirty = true; // Mark as changed
       }
     }
     
     // Clear newly exposed lines
     for (uint8_t y = _height - lines + 1; y <= _height; ++y) {
-      for (uint8_t x = 1; x <= _width; ++x) {
-        uint16_t index = _getIndex(x, y);
-        _buffer[index].character = ' ';
-        _buffer[index].fgColor = getCurrentFgColor();
-        _buffer[index].bgColor = getCurrentBgColor();
-        _buffer[index].attributes = getCurrentAttribute();
-        _buffer[index].dirty = true;
+      AnsiCell *cell = &_buffer[_getIndex(1, y)];
+      for (uint8_t x = 0; x < _width; ++x) {
+        cell[x].character = ' ';
+        cell[x].fgColor = getCurrentFgColor();
+        cell[x].bgColor = getCurrentBgColor();
+        cell[x].attributes = getCurrentAttribute();
+        cell[x].dirty = true;
       }
     }
     
     // Force a full redraw after scrolling to ensure clean update
     _forceFullRedraw = true;
+    QANSI_STAT(_noteRedraw(qANSI_FrameStats::SCROLL));
+  }
+  
+  // Scroll the buffer down by specified number of lines
+  void scrollDown(uint8_t lines = 1) {
+    if (!_buffer || lines == 0) return;
+    
+    // Cap lines to screen height
+    lines = min(lines, _height);
+    
+    // Move content down, clear the newly exposed lines
+    for (uint8_t y = _height; y > lines; --y) {
+      for (uint8_t x = 1; x <= _width; ++x) {
+        _copyCell(_getIndex(x, y), _getIndex(x, y - lines));
+      }
+    }
+    _eraseCells(1, lines, 1, _width);
+    
+    _forceFullRedraw = true;
+    QANSI_STAT(_noteRedraw(qANSI_FrameStats::SCROLL));
   }
 
 
@@ -306,14 +598,7 @@ void debugPrint(const char *str) {
 // Keep this method for printing character strings
 size_t print(const char *str) {
   if (!str || !_buffer) return 0;
-  
-  size_t count = 0;
-  while (*str) {
-    if (write(*str++)) {
-      count++;
-    }
-  }
-  return count;
+  return write((const uint8_t *)str, strlen(str));
 }
 
 // For single character printing
@@ -321,6 +606,30 @@ size_t print(char c) {
   return write(c);
 }
 
+// Pipe-coded literal translated at compile time with QANSI_PIPE(): the style
+// changes are applied from its table and the plain text between them is
+// stored as-is, without going through the pipe code or escape parsers
+size_t print(const qANSI_PipeText &text) {
+  if (!_buffer || _width == 0 || _height == 0) return 0;
+  
+  // A code or sequence left unfinished by write() must not take the text
+  _pipeSequenceState = 0;
+  _ansiState = ANSI_GROUND;
+  
+  uint16_t done = 0;
+  for (uint8_t change = 0; change < text.changeCount; change++) {
+    qANSI_StyleChange next = _readStyleChange(text.changes, change);
+    done += _writeSpanProgmem(text.text + done, next.offset - done);
+    _applySgrState(next.code);
+  }
+  return done + _writeSpanProgmem(text.text + done, text.textLength - done);
+}
+
+size_t println(const qANSI_PipeText &text) {
+  size_t n = print(text);
+  return n + println();
+}
+
 // Add this method to the qANSI_VT class in qANSI_VT.h
 // Empty println() with no arguments - just prints a newline
 size_t println() {
@@ -329,12 +638,8 @@ size_t println() {
 
   // Add a convenience method for displaying a line of text that handles wrapping and scrolling
   size_t println(const char* str) {
-    size_t n = 0;
-    
     // Print the string
-    while (*str) {
-      n += write(*str++);
-    }
+    size_t n = print(str);
     
     // Add newline
     n += write('\n');
@@ -347,67 +652,238 @@ size_t println() {
 // Add these methods to qANSI_VT.h
 
 // --- Integer print variants ---
+// Numbers are formatted on the stack with qANSI_Format and stored straight
+// into the cells (no pipe code or escape scanning). Bases other than 10 use
+// uppercase digits, like Arduino's Print.
 size_t print(int n, int base = DEC) {
-  char buf[8 * sizeof(int) + 1]; // Enough space for binary representation
-  itoa(n, buf, base);
-  return print(buf);
+  return print((long)n, base);
 }
 
 size_t print(unsigned int n, int base = DEC) {
-  char buf[8 * sizeof(unsigned int) + 1];
-  utoa(n, buf, base);
-  return print(buf);
+  return print((unsigned long)n, base);
 }
 
 size_t print(long n, int base = DEC) {
-  char buf[8 * sizeof(long) + 1];
-  ltoa(n, buf, base);
-  return print(buf);
+  return print(n, qANSI_NumberFormat(0, 0, ' ', qANSI_NumberFormat::RIGHT, 0, base));
 }
 
 size_t print(unsigned long n, int base = DEC) {
-  char buf[8 * sizeof(unsigned long) + 1];
-  ultoa(n, buf, base);
-  return print(buf);
+  return print(n, qANSI_NumberFormat(0, 0, ' ', qANSI_NumberFormat::RIGHT, 0, base));
 }
 
 // --- Floating point print variants ---
+// Rounded to the given number of digits (Arduino's Print rounds too)
 size_t print(double n, int digits = 2) {
-  char buf[32]; // Should be sufficient for most double values with reasonable precision
-  
-  // Handle negative numbers
-  size_t count = 0;
-  if (n < 0.0) {
-    count += print('-');
-    n = -n;
+  return print(n, qANSI_NumberFormat(0, digits < 0 ? 0 : digits));
+}
+
+// Alias for float (uses the double implementation)
+size_t print(float n, int digits = 2) {
+  return print((double)n, digits);
+}
+
+// --- Formatted number variants ---
+// Width, alignment, fill, sign and precision from a qANSI_NumberFormat:
+//   vt.print(rpm, qANSI_NumberFormat(5));        // "  850"
+//   vt.print(volts, qANSI_NumberFormat(6, 3));   // " 4.975"
+size_t print(int n, const qANSI_NumberFormat &format) {
+  return print((long)n, format);
+}
+
+size_t print(unsigned int n, const qANSI_NumberFormat &format) {
+  return print((unsigned long)n, format);
+}
+
+size_t print(long n, const qANSI_NumberFormat &format) {
+  char buf[qANSI_Format::BUFFER_SIZE];
+  return _putText(buf, qANSI_Format::formatSigned(buf, n, format));
+}
+
+size_t print(unsigned long n, const qANSI_NumberFormat &format) {
+  char buf[qANSI_Format::BUFFER_SIZE];
+  return _putText(buf, qANSI_Format::formatUnsigned(buf, n, format));
+}
+
+size_t print(double n, const qANSI_NumberFormat &format) {
+  char buf[qANSI_Format::BUFFER_SIZE];
+  return _putText(buf, qANSI_Format::formatFloat(buf, n, format));
+}
+
+// --- Bulk Text ---
+// Store text as-is at the cursor: no pipe codes or escape sequences. Bounds,
+// the cell index and wrapping are worked out once per row segment instead
+// of once per character. Control characters (\r, \n, \t, \b) act as in
+// write(). Returns the number of bytes stored.
+size_t writeSpan(const char *text, size_t length) {
+  if (!_buffer || !text) return 0;
+  const uint8_t *p = (const uint8_t *)text;
+  const uint8_t *end = p + length;
+  while (p < end) {
+    size_t run = _putRun(p, end - p);
+    p += run ? run : _putChar(*p);
+  }
+  return length;
+}
+
+size_t writeSpan(uint8_t col, uint8_t row, const char *text, size_t length) {
+  setCursor(col, row);
+  return writeSpan(text, length);
+}
+
+// --- Rectangles and Lines ---
+// Fill blocks of cells with the current colors and attribute. Rectangles are
+// clipped to the terminal and the cursor does not move. Cells are stored a
+// row span at a time and only cells that change are marked dirty; display()
+// sends the resulting runs as erase or repeat sequences (setRunCompression()).
+void fillRect(uint8_t col, uint8_t row, uint8_t w, uint8_t h, char c = ' ') {
+  _fillRect(col, row, w, h, c, getCurrentAttribute());
+}
+
+// Blank a block in the current colors, like the erase sequences do
+void clearRect(uint8_t col, uint8_t row, uint8_t w, uint8_t h) {
+  _fillRect(col, row, w, h, ' ', qANSI_Attributes::RESET);
+}
+
+void drawHLine(uint8_t col, uint8_t row, uint8_t length, char c = '-') {
+  fillRect(col, row, length, 1, c);
+}
+
+void drawVLine(uint8_t col, uint8_t row, uint8_t length, char c = '|') {
+  fillRect(col, row, 1, length, c);
+}
+
+// Outline a block with one of the qANSI_Box styles (or any six glyphs in
+// the same order). The inside is left unchanged.
+void drawBox(uint8_t col, uint8_t row, uint8_t w, uint8_t h, const char *style = qANSI_Box::ASCII) {
+  if (w == 0 || h == 0) return;
+  uint8_t attr = getCurrentAttribute();
+  uint16_t right = col + w - 1;
+  uint16_t bottom = row + h - 1;
+  if (h == 1) {
+    _fillRect(col, row, w, 1, style[4], attr);
+  } else if (w == 1) {
+    _fillRect(col, row, 1, h, style[5], attr);
+  } else {
+    _fillRect(col, row, 1, 1, style[0], attr);
+    _fillRect(right, row, 1, 1, style[1], attr);
+    _fillRect(col, bottom, 1, 1, style[2], attr);
+    _fillRect(right, bottom, 1, 1, style[3], attr);
+    _fillRect(col + 1, row, w - 2, 1, style[4], attr);
+    _fillRect(col + 1, bottom, w - 2, 1, style[4], attr);
+    _fillRect(col, row + 1, 1, h - 2, style[5], attr);
+    _fillRect(right, row + 1, 1, h - 2, style[5], attr);
+  }
+}
+
+// --- Blit and Sprites ---
+// Copy a block of cells (characters and style) from another terminal, or
+// from elsewhere in this one; overlapping copies work like memmove(). The
+// block is clipped to both terminals and only cells that change are marked
+// dirty. Returns the number of cells changed.
+uint16_t blit(const qANSI_VT &src, const qANSI_Rect &rect, uint8_t col, uint8_t row) {
+  if (!_buffer || !src._buffer || rect.col < 1 || rect.row < 1 || col < 1 || row < 1 ||
+      rect.col > src._width || rect.row > src._height || col > _width || row > _height) {
+    return 0;
   }
+  uint8_t w = min(rect.width, (uint8_t)min(src._width - rect.col + 1, _width - col + 1));
+  uint8_t h = min(rect.height, (uint8_t)min(src._height - rect.row + 1, _height - row + 1));
+  if (w == 0 || h == 0) return 0;
   
-  // Extract the integer part
-  unsigned long int_part = (unsigned long)n;
-  double remainder = n - (double)int_part;
+  // Copying down or right within one buffer goes backwards, so no cell is
+  // read after it was overwritten
+  bool backward = (&src == this) && (row > rect.row || (row == rect.row && col > rect.col));
+  uint16_t changed = 0;
+  for (uint8_t i = 0; i < h; i++) {
+    uint8_t dy = backward ? h - 1 - i : i;
+    const AnsiCell *from = &src._buffer[src._getIndex(rect.col, rect.row + dy)];
+    AnsiCell *to = &_buffer[_getIndex(col, row + dy)];
+    for (uint8_t j = 0; j < w; j++) {
+      uint8_t dx = backward ? w - 1 - j : j;
+      const AnsiCell &cell = from[dx];
+      changed += _storeCell(to[dx], cell.character, cell.fgColor, cell.bgColor, cell.attributes);
+    }
+  }
+  return changed;
+}
+
+// Show a sprite at col/row, or move it there if it is shown. The cells it
+// uncovers get their saved contents back; where old and new position
+// overlap, cells that end up the same are not marked dirty. Sprites that
+// overlap each other have to be hidden in the reverse order they were
+// shown. Returns the number of cells changed.
+uint16_t showSprite(qANSI_Sprite &sprite, uint8_t col, uint8_t row) {
+  if (!_buffer || !sprite.image || !sprite.saved || col < 1 || row < 1) return 0;
+  uint16_t changed = 0;
   
-  // Print integer part
-  count += print(int_part);
+  // Restore cells that the sprite no longer covers
+  if (sprite.shown) {
+    changed += _restoreSprite(sprite, col, row);
+  }
   
-  // Handle decimal part if needed
-  if (digits > 0) {
-    count += print('.');
-    
-    // Scale the remainder to the desired precision
-    while (digits-- > 0) {
-      remainder *= 10.0;
-      int digit = (int)remainder;
-      count += print(digit);
-      remainder -= digit;
+  // Save what is below the new position. Cells under the old position come
+  // from the backing store, which shifts by a constant offset, so it is
+  // walked in the direction of memmove().
+  int32_t shift = ((int32_t)row - sprite.row) * sprite.width + ((int32_t)col - sprite.col);
+  bool backward = sprite.shown && shift < 0;
+  uint16_t count = (uint16_t)sprite.width * sprite.height;
+  for (uint16_t n = 0; n < count; n++) {
+    uint16_t i = backward ? count - 1 - n : n;
+    uint16_t x = col + i % sprite.width;
+    uint16_t y = row + i / sprite.width;
+    if (x > _width || y > _height) continue;
+    if (sprite.shown && _spriteOpaqueAt(sprite, x, y)) {
+      sprite.saved[i] = sprite.saved[i + shift];
+    } else {
+      sprite.saved[i] = _buffer[_getIndex(x, y)];
     }
   }
   
-  return count;
+  // Draw the sprite; transparent cells show the saved cell, which differs
+  // from the buffer where the sprite was before
+  sprite.col = col;
+  sprite.row = row;
+  sprite.shown = true;
+  for (uint16_t i = 0; i < count; i++) {
+    uint16_t x = col + i % sprite.width;
+    uint16_t y = row + i / sprite.width;
+    if (x > _width || y > _height) continue;
+    bool clear = sprite.transparent && sprite.image[i].character == sprite.transparent;
+    const AnsiCell &cell = clear ? sprite.saved[i] : sprite.image[i];
+    changed += _storeCell(_buffer[_getIndex(x, y)], cell.character, cell.fgColor, cell.bgColor,
+                          cell.attributes);
+  }
+  return changed;
 }
 
-// Alias for float (uses the double implementation)
-size_t print(float n, int digits = 2) {
-  return print((double)n, digits);
+// Put back what the sprite covered
+uint16_t hideSprite(qANSI_Sprite &sprite) {
+  if (!_buffer || !sprite.shown) return 0;
+  uint16_t changed = _restoreSprite(sprite, 0, 0);
+  sprite.shown = false;
+  return changed;
+}
+
+// --- printf-style Output ---
+// The format string is checked at compile time and kept in flash:
+//   vt.printf(QANSI_FORMAT("%-8s %6.1f C"), name, temperature);
+//   vt.printAt(1, 3, QANSI_FORMAT("RPM %5u"), rpm);
+// The format text goes through write() like print(), so pipe codes work.
+// Arguments are formatted on the stack and stored as plain text straight
+// into the cells: no heap, no intermediate string.
+template<class Literal, class... Args>
+size_t printf(const qANSI_FormatString<Literal> &format, const Args &... args) {
+  static_assert(qANSI_Format::countArgs(Literal::str()) == (int)sizeof...(Args),
+                "Wrong number of arguments for the QANSI_FORMAT string");
+  static_assert(qANSI_Format::CheckArgs<Literal, 0, Args...>::value, "");
+  if (!_buffer) return 0;
+  const char *p = format.text;
+  return _printfNext(p, args...);
+}
+
+template<class Literal, class... Args>
+size_t printAt(uint8_t col, uint8_t row, const qANSI_FormatString<Literal> &format, const Args &... args) {
+  setCursor(col, row);
+  return printf(format, args...);
 }
 
 // --- String type variants ---
@@ -474,6 +950,29 @@ size_t println(float num, int digits = 2) {
   return println((double)num, digits);
 }
 
+size_t println(int num, const qANSI_NumberFormat &format) {
+  return println((long)num, format);
+}
+
+size_t println(unsigned int num, const qANSI_NumberFormat &format) {
+  return println((unsigned long)num, format);
+}
+
+size_t println(long num, const qANSI_NumberFormat &format) {
+  size_t n = print(num, format);
+  return n + println();
+}
+
+size_t println(unsigned long num, const qANSI_NumberFormat &format) {
+  size_t n = print(num, format);
+  return n + println();
+}
+
+size_t println(double num, const qANSI_NumberFormat &format) {
+  size_t n = print(num, format);
+  return n + println();
+}
+
 #ifdef Arduino_h
 size_t println(const String &s) {
   size_t n = print(s);
@@ -494,21 +993,111 @@ size_t println(const Printable &p) {
 
 
   // --- Write Character (Core Print Method) ---
+// Pipe codes change the current style without sending anything; the styled
+// cells go out through display()
 virtual size_t write(uint8_t c) override {
   if (!_buffer || _width == 0 || _height == 0) return 0;
+  
+  // Escape sequences go to the ANSI parser (a started pipe code is finished first)
+  if (_ansiParsingEnabled && _pipeSequenceState == 0 && (_ansiState != ANSI_GROUND || c == 0x1B)) {
+    _ansiInput(c);
+    return 1;
+  }
+  
+  if (!_pipeCodesEnabled) {
+    return _putChar(c);
+  }
+  
+  // Same state machine as qANSI::write()
+  switch (_pipeSequenceState) {
+    case 0: // Not in a pipe sequence
+      if (c == '|') {
+        _pipeSequenceState = 1;
+        return 1;
+      }
+      return _putChar(c);
+      
+    case 1: // Got a pipe, waiting for first command character
+      _pipeChar1 = c;
+      _pipeSequenceState = 2;
+      return 1;
+      
+    case 2: // Got first command char, waiting for second command char
+      _pipeSequenceState = 0;
+      return _decodePipeCode(_pipeChar1, c);
+      
+    default:
+      _pipeSequenceState = 0;
+      return _putChar(c);
+  }
+}
+
+  // Bulk writes go into the buffer, not straight to the output. Plain text
+  // between pipe codes and escape sequences is stored without per-byte
+  // virtual dispatch.
+  virtual size_t write(const uint8_t *buffer, size_t size) override {
+    if (!_buffer || _width == 0 || _height == 0) return 0;
+    
+    size_t count = 0;
+    const uint8_t *end = buffer + size;
+    const uint8_t *nextPipe = buffer;  // Cached memchr() results, end = none left
+    const uint8_t *nextEsc = buffer;
+    while (buffer < end) {
+      // Finish a pipe code or escape sequence that was started earlier
+      if ((_pipeCodesEnabled && _pipeSequenceState != 0) ||
+          (_ansiParsingEnabled && _ansiState != ANSI_GROUND)) {
+        count += write(*buffer++);
+        continue;
+      }
+      
+      if (nextPipe < buffer || (nextPipe == buffer && nextPipe != end)) {
+        nextPipe = _findByte(buffer, end, '|', _pipeCodesEnabled);
+      }
+      if (nextEsc < buffer || (nextEsc == buffer && nextEsc != end)) {
+        nextEsc = _findByte(buffer, end, 0x1B, _ansiParsingEnabled);
+      }
+      
+      const uint8_t *spanEnd = nextPipe < nextEsc ? nextPipe : nextEsc;
+      while (buffer < spanEnd) {
+        size_t run = _putRun(buffer, spanEnd - buffer);
+        if (run) {
+          buffer += run;
+          count += run;
+        } else {
+          count += _putChar(*buffer++);
+        }
+      }
+      if (buffer == end) break;
+      
+      if (buffer == nextEsc) {
+        count += write(*buffer++); // Enters the parser
+        continue;
+      }
+      
+      if (end - buffer >= 3) {
+        count += 2 + _decodePipeCode(buffer[1], buffer[2]);
+        buffer += 3;
+      } else {
+        count += write(*buffer++); // Code continues in the next call
+      }
+    }
+    return count;
+  }
 
+  // --- Store Character in the Buffer ---
+inline size_t _putChar(uint8_t c) {
   // Handle special characters
   if (c == '\n') {
     // Newline moves to beginning of next line
     _cursorX = 1;
-    _cursorY++;
+    if (_cursorY <= _height) _cursorY++;
     
     // Handle scrolling if enabled
     if (_cursorY > _height && _scrollEnabled) {
       scrollUp(1);
       _cursorY = _height;
     }
-    // If scrolling disabled, allow cursor outside bounds
+    // If scrolling disabled, allow cursor one row below the bounds
     // but don't modify it further
   } 
   else if (c == '\r') {
@@ -519,10 +1108,17 @@ virtual size_t write(uint8_t c) override {
       _cursorX--;
     }
   }
+  else if (c == '\t') {
+    // Next tab stop (every 8 columns), never past the right edge
+    uint16_t stop = ((_cursorX - 1) / 8 + 1) * 8 + 1;
+    _cursorX = stop > _width ? _width : stop;
+  }
   else if (c >= 32) { // Printable characters
     // Only write if cursor is in bounds
     if (_cursorX >= 1 && _cursorX <= _width && _cursorY >= 1 && _cursorY <= _height) {
-      uint16_t index = _getIndex(_cursorX, _cursorY);
+      // In bounds, only a deferred clear needs resolving (see _getIndex())
+      if (_rowEpoch[_cursorY - 1] != _clearEpoch) _resolveRow(_cursorY);
+      uint16_t index = (_cursorY - 1) * _width + (_cursorX - 1);
       
       // Update cell
       _buffer[index].character = (char)c;
@@ -536,224 +1132,1024 @@ virtual size_t write(uint8_t c) override {
     
     // Handle line wrapping
     if (_cursorX > _width) {
-      if (_lineWrappingEnabled) {
-        _cursorX = 1;  // Move to start of next line
-        _cursorY++;    // Move to next line
-        
-        // Handle scrolling if needed and enabled
-        if (_cursorY > _height && _scrollEnabled) {
-          scrollUp(1);
-          _cursorY = _height;
-        }
-        // If scrolling disabled, leave cursor outside bounds
-      } else {
-        // Without wrapping, clamp at right edge
-        _cursorX = _width;
-      }
+      _wrapCursor();
     }
   }
   
   return 1;
 }
 
-  // --- Display Update ---
-// --- Display Update ---
-void display() {
-  if (!_buffer) return;
-  
-  // Hide cursor during updates
-  if (!isCursorVisible()) {
-    _sendAnsiCommand("\033[?25l");
-  }
-  
-  // Analyze buffer to determine optimal update strategy
-  bool hasChanges = false;
-  uint16_t dirtyCount = 0;
-  uint8_t dirtyRows = 0;
-  bool rowIsDirty[_height + 1] = {false}; // 1-based rows
-  
-  // Skip analysis if full redraw is forced
-  if (!_forceFullRedraw) {
-    // Count dirty cells and mark dirty rows
-    for (uint8_t y = 1; y <= _height; y++) {
-      bool rowHasDirty = false;
-      for (uint8_t x = 1; x <= _width; x++) {
-        uint16_t index = _getIndex(x, y);
-        if (_buffer[index].dirty) {
-          dirtyCount++;
-          rowHasDirty = true;
-          hasChanges = true;
-        }
-      }
+  // The cursor moved past the last column: wrap (scrolling if needed) or,
+  // without wrapping, clamp at the right edge
+  void _wrapCursor() {
+    if (_lineWrappingEnabled) {
+      _cursorX = 1;  // Move to start of next line
+      if (_cursorY <= _height) _cursorY++; // Move to next line
       
-      if (rowHasDirty) {
-        dirtyRows++;
-        rowIsDirty[y] = true;
+      // Handle scrolling if needed and enabled
+      if (_cursorY > _height && _scrollEnabled) {
+        scrollUp(1);
+        _cursorY = _height;
       }
+      // If scrolling disabled, leave cursor one row below the bounds
+    } else {
+      _cursorX = _width;
     }
+  }
+
+  // Next occurrence of a byte in [from, end), or end if none (or not enabled)
+  static const uint8_t *_findByte(const uint8_t *from, const uint8_t *end, uint8_t c, bool enabled) {
+    const uint8_t *found = enabled ? (const uint8_t *)memchr(from, c, end - from) : nullptr;
+    return found ? found : end;
+  }
+
+  // Store a run of printable characters on the cursor row, up to and
+  // including the last column: bounds and the cell index are worked out once
+  // per row segment, and the cursor wraps (or scrolls) once at its end.
+  // Returns the number of bytes stored (0 if the next byte must go through
+  // _putChar()).
+  size_t _putRun(const uint8_t *text, size_t length) {
+    if (_cursorY < 1 || _cursorY > _height || _cursorX < 1 || _cursorX > _width) return 0;
+    size_t room = _width - _cursorX + 1;
+    if (length > room) length = room;
     
-    // Force full redraw if too many cells are dirty (70% threshold)
-    if (dirtyCount > (_width * _height * 0.7)) {
-      _forceFullRedraw = true;
+    AnsiCell *cell = &_buffer[_getIndex(_cursorX, _cursorY)];
+    AnsiCell style;
+    style.fgColor = getCurrentFgColor();
+    style.bgColor = getCurrentBgColor();
+    style.attributes = getCurrentAttribute();
+    style.dirty = true;
+    size_t n = 0;
+    while (n < length && text[n] >= 32) {
+      style.character = (char)text[n++];
+      *cell++ = style;
     }
-  } else {
-    hasChanges = true;
+    if (n == room) {
+      _cursorX = _width;  // Past the last column (without overflowing uint8_t)
+      _wrapCursor();
+    } else {
+      _cursorX += n;
+    }
+    return n;
   }
-  
-  // Skip update if nothing changed (optimization)
-  if (!hasChanges && !_forceFullRedraw) {
-    return;
+
+  // Store formatted text. It does not start pipe codes or escape sequences,
+  // but finishes one that is in progress (e.g. printf(QANSI_FORMAT("\033[%dC"), n)).
+  size_t _putText(const char *text, size_t length) {
+    if (!_buffer || _width == 0 || _height == 0) return 0;
+    size_t i = 0;
+    while (i < length && (_pipeSequenceState != 0 || _ansiState != ANSI_GROUND)) {
+      write((uint8_t)text[i++]);
+    }
+    return i + writeSpan(text + i, length - i);
   }
-  
-  // Initialize drawing state
-  resetAttributes();
-  _terminalAttr = qANSI_Attributes::RESET;
-  _terminalFg = qANSI_Colors::FG_DEFAULT;
-  _terminalBg = qANSI_Colors::BG_DEFAULT;
-  
-  // === DRAWING STRATEGY SELECTION ===
-  
-  if (_forceFullRedraw) {
-    // === FULL REDRAW: Draw everything row-by-row ===
-    for (uint8_t y = 1; y <= _height; y++) {
-      // Position at start of each row
-      qANSI::setCursor(_posX, _posY + y - 1);
-      _terminalCursorX = _posX;
-      _terminalCursorY = _posY + y - 1;
-      
-      // Draw entire row
-      for (uint8_t x = 1; x <= _width; x++) {
-        uint16_t index = _getIndex(x, y);
-        
-        // Update cell appearance
-        _updateCellAppearance(index);
-        
-        // Write character
-        _output.write(_buffer[index].character);
-        _terminalCursorX++;
-        
-        // No longer dirty
-        _buffer[index].dirty = false;
-      }
+
+  // writeSpan() for text stored in flash (AVR) or regular memory
+  size_t _writeSpanProgmem(const char *text, size_t length) {
+#if defined(__AVR__)
+    char chunk[16];
+    for (size_t i = 0; i < length; i += sizeof(chunk)) {
+      size_t n = length - i < sizeof(chunk) ? length - i : sizeof(chunk);
+      memcpy_P(chunk, text + i, n);
+      writeSpan(chunk, n);
     }
-  } 
-  else if (dirtyRows <= _height * 0.3) {
-    // === SPARSE UPDATE: Only specific dirty cells in selected rows ===
-    // Optimized for when a small number of rows have changes
-    
-    for (uint8_t y = 1; y <= _height; y++) {
-      if (!rowIsDirty[y]) continue;
-      
-      // Special optimization for borders (rows 1 and _height)
-      if (y == 1 || y == _height) {
-        // Draw entire border row to ensure consistency
-        qANSI::setCursor(_posX, _posY + y - 1);
-        _terminalCursorX = _posX;
-        _terminalCursorY = _posY + y - 1;
-        
-        for (uint8_t x = 1; x <= _width; x++) {
-          uint16_t index = _getIndex(x, y);
-          _updateCellAppearance(index);
-          _output.write(_buffer[index].character);
-          _terminalCursorX++;
-          _buffer[index].dirty = false;
-        }
-      } 
-      else {
-        // Normal row - locate sequences of dirty cells for batch updates
-        uint8_t dirtyStart = 0;
-        uint8_t scanPos = 1;
-        
-        while (scanPos <= _width) {
-          // Check for dirty sequence start
-          if (dirtyStart == 0 && _buffer[_getIndex(scanPos, y)].dirty) {
-            dirtyStart = scanPos;
-          }
-          
-          // Check for sequence end or buffer end
-          if (dirtyStart > 0 && 
-              (scanPos == _width || !_buffer[_getIndex(scanPos, y)].dirty)) {
-            
-            // We found a sequence from dirtyStart to scanPos-1
-            // Position cursor at start of dirty sequence
-            qANSI::setCursor(_posX + dirtyStart - 1, _posY + y - 1);
-            _terminalCursorX = _posX + dirtyStart - 1;
-            _terminalCursorY = _posY + y - 1;
-            
-            // Draw the sequence
-            for (uint8_t x = dirtyStart; x < scanPos; x++) {
-              uint16_t index = _getIndex(x, y);
-              _updateCellAppearance(index);
-              _output.write(_buffer[index].character);
-              _terminalCursorX++;
-              _buffer[index].dirty = false;
-            }
-            
-            // Reset sequence start
-            dirtyStart = 0;
-          }
-          
-          scanPos++;
-        }
+    return length;
+#else
+    return writeSpan(text, length);
+#endif
+  }
+
+  // --- printf Helpers ---
+  // Write format text up to the next specification (p is left after its '%')
+  size_t _printfLiteral(const char *&p) {
+    char chunk[32];
+    uint8_t n = 0;
+    size_t count = 0;
+    for (;;) {
+      char c = pgm_read_byte(p);
+      if (c == 0) break;
+      p++;
+      if (c == '%') {
+        if (pgm_read_byte(p) != '%') break;
+        p++;
       }
-    }
-  } 
-  else {
-    // === ROW-BASED UPDATE: Draw complete rows that have any changes ===
-    // More efficient when many scattered changes exist
-    
-    for (uint8_t y = 1; y <= _height; y++) {
-      if (!rowIsDirty[y]) continue;
-      
-      // Position at start of row
-      qANSI::setCursor(_posX, _posY + y - 1);
-      _terminalCursorX = _posX;
-      _terminalCursorY = _posY + y - 1;
-      
-      // Draw entire row
-      for (uint8_t x = 1; x <= _width; x++) {
-        uint16_t index = _getIndex(x, y);
-        _updateCellAppearance(index);
-        _output.write(_buffer[index].character);
-        _terminalCursorX++;
-        _buffer[index].dirty = false;
+      chunk[n++] = c;
+      if (n == sizeof(chunk)) {
+        count += write((const uint8_t *)chunk, n);
+        n = 0;
       }
     }
+    if (n) count += write((const uint8_t *)chunk, n);
+    return count;
   }
+
+  size_t _printfNext(const char *&p) {
+    return _printfLiteral(p);
+  }
+
+  template<class A, class... Args>
+  size_t _printfNext(const char *&p, const A &arg, const Args &... args) {
+    size_t count = _printfLiteral(p);
+    qANSI_NumberFormat format;
+    char conversion = qANSI_Format::parseSpec(p, format);
+    count += _printfArg(conversion, format, (typename qANSI_Format::Arg<A>::type)arg, sizeof(A));
+    return count + _printfNext(p, args...);
+  }
+
+  size_t _printfArg(char conversion, const qANSI_NumberFormat &format, long value, uint8_t size) {
+    if (conversion == 'c') return _printfArg(conversion, format, (char)value, 1);
+    if (conversion == 'f' || conversion == 'F' || conversion == 'g') return print((double)value, format);
+    if (conversion == 'd' || conversion == 'i') return print(value, format);
+    
+    // Unsigned conversions show the bits of the argument's own size
+    unsigned long bits = (unsigned long)value;
+    if (size < sizeof(long)) bits &= (1UL << (size * 8)) - 1;
+    return print((unsigned long)bits, format);
+  }
+
+  size_t _printfArg(char conversion, const qANSI_NumberFormat &format, unsigned long value, uint8_t) {
+    if (conversion == 'c') return _printfArg(conversion, format, (char)value, 1);
+    if (conversion == 'f' || conversion == 'F' || conversion == 'g') return print((double)value, format);
+    return print(value, format);
+  }
+
+  size_t _printfArg(char, const qANSI_NumberFormat &format, double value, uint8_t) {
+    return print(value, format);
+  }
+
+  size_t _printfArg(char conversion, const qANSI_NumberFormat &format, char value, uint8_t size) {
+    if (conversion != 'c') return _printfArg(conversion, format, (long)value, size);
+    return _printfText(&value, 1, format, false);
+  }
+
+  size_t _printfArg(char, const qANSI_NumberFormat &format, const char *value, uint8_t) {
+    return _printfText(value, value ? strlen(value) : 0, format, false);
+  }
+
+  size_t _printfArg(char, const qANSI_NumberFormat &format, const __FlashStringHelper *value, uint8_t) {
+    const char *text = reinterpret_cast<const char *>(value);
+    size_t length = 0;
+    while (text && pgm_read_byte(text + length)) length++;
+    return _printfText(text, length, format, true);
+  }
+
+  // Text padded to the field width with spaces (also with the '0' flag); a
+  // precision, if given, limits the length
+  size_t _printfText(const char *text, size_t length, const qANSI_NumberFormat &format, bool flash) {
+    if (format.precision != 0xFF && format.precision < length) length = format.precision;
+    uint8_t pad = format.width > length ? format.width - length : 0;
+    uint8_t before = (format.align == qANSI_NumberFormat::RIGHT) ? pad :
+                     (format.align == qANSI_NumberFormat::CENTER) ? pad / 2 : 0;
+    for (uint8_t i = 0; i < before; i++) _putText(" ", 1);
+    if (flash) {
+      char chunk[16];
+      for (size_t i = 0; i < length; i += sizeof(chunk)) {
+        size_t n = length - i < sizeof(chunk) ? length - i : sizeof(chunk);
+        memcpy_P(chunk, text + i, n);
+        _putText(chunk, n);
+      }
+    } else {
+      _putText(text, length);
+    }
+    for (uint8_t i = before; i < pad; i++) _putText(" ", 1);
+    return length + pad;
+  }
+
+  // --- Display Update ---
+// --- Display Update ---
+// Renders pending changes to the physical terminal. With the default (unlimited)
+// budget the whole frame is sent in one call. With a byte and/or time budget the
+// frame may be split over several calls: the position in the dirty map is kept
+// and the next call resumes the same frame. Returns true once the frame is
+// complete (or there was nothing to draw), false while more output is pending.
+// Sinks added with addSink() are served after the terminal's own output.
+bool display(const qANSI_Budget &budget = qANSI_Budget()) {
+  if (!_buffer) return true;
   
-  // Reset full redraw flag
-  _forceFullRedraw = false;
-  
-  // Position cursor or hide it as needed
-  if (isCursorVisible()) {
-    qANSI::setCursor(_posX + _cursorX - 1, _posY + _cursorY - 1);
-    _sendAnsiCommand("\033[?25h"); // Show cursor
+  // Sinks take the changes as written, the front buffer is what the own
+  // output shows
+  if (_sinkCount > 0) _collectSinkChanges();
+  bool complete = true;
+  if (!_front || _frameActive || _forceFullRedraw || _diffFront()) {
+    complete = _displayFrame(budget);
+  }
+  if (_sinkCount > 0) _displaySinks();
+  return complete;
+}
+
+// display() for the terminal's own output
+bool _displayFrame(const qANSI_Budget &budget) {
+  
+  // A full redraw requested mid-frame (e.g. by scrollUp() or setPosition())
+  // restarts the frame, cells sent so far may be stale
+  if (_frameActive && _forceFullRedraw) {
+    _frameActive = false;
+  }
+  
+  bool resumed = _frameActive;
+  if (!_frameActive) {
+    // Analyze buffer to determine optimal update strategy
+    uint16_t dirtyCount = 0;
+    uint8_t dirtyRows = 0;
+    
+    // Skip analysis if full redraw is forced
+    if (!_forceFullRedraw) {
+      // Count dirty cells and dirty rows
+      for (uint8_t y = 1; y <= _height; y++) {
+        bool rowHasDirty = false;
+        const AnsiCell *cell = &_buffer[_getIndex(1, y)];
+        for (uint8_t x = 0; x < _width; x++) {
+          if (cell[x].dirty) {
+            dirtyCount++;
+            rowHasDirty = true;
+          }
+        }
+        if (rowHasDirty) dirtyRows++;
+      }
+      
+      // Skip update if nothing changed (optimization)
+      if (dirtyCount == 0) return true;
+      
+      // Force full redraw if too many cells are dirty (70% threshold)
+      if (dirtyCount > (_width * _height * 0.7)) {
+        _forceFullRedraw = true;
+        QANSI_STAT(_noteRedraw(qANSI_FrameStats::THRESHOLD));
+      }
+    }
+    
+    // === DRAWING STRATEGY SELECTION ===
+    if (_forceFullRedraw) {
+      _frameStrategy = FRAME_FULL;      // Draw everything row-by-row
+      
+      // Every cell is sent, so priority regions can go first
+      size_t bufferSize = (size_t)_width * _height;
+      for (size_t i = 0; i < bufferSize; ++i) {
+        _buffer[i].dirty = true;
+      }
+    } else if (dirtyRows <= _height * 0.3) {
+      _frameStrategy = FRAME_SPARSE;    // Only dirty cells in the dirty rows
+    } else {
+      _frameStrategy = FRAME_ROWS;      // Complete rows that have any changes
+    }
+    
+    QANSI_STAT(_beginFrameStats(dirtyCount ? dirtyCount : (uint16_t)(_width * _height)));
+    
+    _forceFullRedraw = false;
+    _frameActive = true;
+    _frameRow = 1;
+    _frameCol = 1;
+  }
+  
+  // Other writers may share the stream between calls, so the physical cursor
+  // and attributes are re-synchronized at the start of every call
+  _terminalStateKnown = false;
+  _beginBudget(budget);
+  
+  // Prologue and epilogue must fit, otherwise nothing is sent this call
+  if (!_beginOutput()) return false;
+  
+  // Priority regions are sent before the rest of the frame
+  bool complete = true;
+  if (_regionCount > 0) {
+    _observeRegions();
+    complete = _drawRegions();
+  }
+  
+  // Resume the frame where the previous call stopped. Cells that changed
+  // behind that point while the frame was pending get another pass, so a
+  // complete frame leaves nothing dirty.
+  for (;;) {
+    for (; complete && _frameRow <= _height; _frameRow++, _frameCol = 1) {
+      uint8_t y = _frameRow;
+    
+      // Skip rows that have nothing to send. A row that was started in an
+      // earlier call is finished regardless.
+      if (_frameCol == 1 && !_rowHasDirty(y)) {
+        continue;
+      }
+    
+      // The row strategy resends unchanged cells, except those a priority
+      // region has already sent
+      bool wholeRow = (_frameStrategy == FRAME_ROWS) ||
+                      (_frameStrategy == FRAME_SPARSE && (y == 1 || y == _height)); // Border rows keep their consistency
+    
+      uint8_t stopped = _drawRow(y, _frameCol, wholeRow);
+      if (stopped) {
+        _frameCol = stopped;
+        complete = false;
+        break;
+      }
+    }
+    if (!complete || !resumed || !_hasDirtyCells()) break;
+    resumed = false;
+    _frameRow = 1;
+    _frameCol = 1;
+  }
+  
+  if (complete) {
+    _frameActive = false;
+  }
+  
+  if (_regionCount > 0) {
+    _retireRegions();
+  }
+  
+  _endOutput();
+  
+  // Output above bypassed the direct-mode state tracking
+  invalidateTerminalState();
+  
+  QANSI_STAT(_endFrameStats(complete));
+  return complete;
+}
+
+// True while a budget-limited frame still has output pending
+bool isFramePending() const {
+  return _frameActive;
+}
+
+// Bytes sent by the most recent display() call
+uint32_t getLastDisplayBytes() const {
+  return _budgetBytes;
+}
+
+// --- Run Compression ---
+// Runs of identical cells on a row can go out as one sequence instead of
+// one byte per cell: blanks as ECH (CSI n X, erase characters) and other
+// characters as the character followed by REP (CSI n b, repeat). A run is
+// only compressed when that is shorter. ECH is a VT220 sequence and on by
+// default. It is only used for blanks with the default background: on
+// terminals without background color erase (bce) erased cells always get
+// the default background. REP is newer (xterm, VTE, Windows Terminal, not
+// PuTTY) and has to be enabled.
+enum { RUN_ERASE = 1, RUN_REPEAT = 2 };
+
+void setRunCompression(uint8_t modes) {
+  _runModes = modes;
+}
+
+uint8_t getRunCompression() const {
+  return _runModes;
+}
+
+// --- Front Buffer ---
+// display() normally sends every cell written since the last frame, also
+// when it was written with what it already showed (e.g. a page that is
+// cleared and printed again on every loop). With a front buffer the terminal
+// keeps a copy of what was last sent, and a new frame starts by comparing
+// the buffer against it: only cells that differ are sent. The compare runs
+// a machine word at a time (16 cells at a time with SSE2), so a frame with
+// no changes costs one pass over the buffer. Doubles the buffer memory.
+// Returns false if the copy can't be allocated.
+bool enableFrontBuffer(bool enable = true) {
+  if (!enable) {
+    delete[] _front;
+    _front = nullptr;
+    return true;
+  }
+  if (!_buffer) return false;
+  if (_front) return true;
+  
+  size_t cells = (size_t)_width * _height;
+  _front = new AnsiCell[cells];
+  if (!_front) return false;
+  
+  // Cells without a pending change are on the screen, the others are unknown
+  _resolveRows();
+  for (size_t i = 0; i < cells; i++) {
+    if (_buffer[i].dirty) memset(&_front[i], 0, sizeof(AnsiCell));
+    else _front[i] = _buffer[i];
+  }
+  return true;
+}
+
+bool isFrontBufferEnabled() const {
+  return _front != nullptr;
+}
+
+// --- Additional Output Streams ---
+// display() can mirror the terminal to more streams (a second UART, a telnet
+// client, USB CDC) without a second buffer. The changes are collected once
+// per display() call; each sink then gets the cells it has not been sent,
+// encoded with its own cursor and style tracking, run compression modes and
+// budget. A sink that is added late, or could not take a whole frame within
+// its budget, catches up with the current contents on its own without
+// holding back the other outputs. The terminal appears at the same position
+// on every stream. Returns the sink id, or -1 if the table is full.
+int8_t addSink(Stream &stream, uint8_t runModes = RUN_ERASE, const qANSI_Budget &budget = qANSI_Budget()) {
+  if (!_buffer) return -1;
+  if (!_sinks) {
+    _sinks = new qANSI_Sink[QANSI_MAX_SINKS];
+    if (!_sinks) return -1;
+  }
+  if (_sinkCount >= QANSI_MAX_SINKS) return -1;
+  
+  qANSI_Sink &sink = _sinks[_sinkCount];
+  sink.pending = new uint8_t[_pendingSize()];
+  if (!sink.pending) return -1;
+  sink.stream = &stream;
+  sink.budget = budget;
+  sink.runModes = runModes;
+  sink.cursorCol = 0xFF;
+  sink.cursorRow = 0;
+  sink.bytes = 0;
+  sink.acked = nullptr;
+  sink.sent = nullptr;
+  sink.hook = nullptr;
+  sink.context = nullptr;
+  sink.frame = 0;
+  sink.inFlight = false;
+  _markPending(sink.pending);
+  return _sinkCount++;
+}
+
+// A plain sink is written as fast as display() is called, so a link slower
+// than the update rate queues every intermediate frame and falls further
+// behind. A state sync sink instead remembers the screen the remote end has
+// acknowledged and keeps at most one frame in flight: display() sends
+// nothing while it waits, and the next frame is the difference between the
+// acknowledged screen and the current contents. Intermediate states are
+// skipped, so the remote end lags by at most one frame. hook (may be
+// nullptr, see getSinkFrame()) learns the number of each frame sent; the
+// transport passes it to acknowledgeSink() when the remote end has it. The
+// link has to deliver frames in order. Two copies of the buffer are
+// allocated. Returns the sink id, or -1 on failure.
+int8_t addSyncSink(Stream &stream, qANSI_SyncHook hook, void *context = nullptr,
+                   uint8_t runModes = RUN_ERASE, const qANSI_Budget &budget = qANSI_Budget()) {
+  int8_t id = addSink(stream, runModes, budget);
+  if (id < 0) return -1;
+  
+  qANSI_Sink &sink = _sinks[id];
+  size_t cells = (size_t)_width * _height;
+  sink.acked = new AnsiCell[cells];
+  sink.sent = new AnsiCell[cells];
+  if (!sink.acked || !sink.sent) {
+    delete[] sink.acked;
+    delete[] sink.sent;
+    delete[] sink.pending;
+    _sinkCount--;
+    return -1;
+  }
+  sink.hook = hook;
+  sink.context = context;
+  _forgetCells(sink.acked);
+  return id;
+}
+
+// The remote end of a state sync sink has frame. Returns false if it is not
+// the frame in flight (e.g. it was dropped and sent again since).
+bool acknowledgeSink(uint8_t id, uint16_t frame) {
+  if (id >= _sinkCount) return false;
+  qANSI_Sink &sink = _sinks[id];
+  if (!sink.acked || !sink.inFlight || frame != sink.frame) return false;
+  AnsiCell *acked = sink.sent;
+  sink.sent = sink.acked;
+  sink.acked = acked;
+  sink.inFlight = false;
+  return true;
+}
+
+// The frame in flight was lost: the next display() sends the differences to
+// the acknowledged screen again
+void dropSinkFrame(uint8_t id) {
+  if (id >= _sinkCount || !_sinks[id].acked) return;
+  _sinks[id].inFlight = false;
+  _sinks[id].cursorCol = 0xFF;
+}
+
+// Number of the last frame sent to a state sync sink
+uint16_t getSinkFrame(uint8_t id) const {
+  return id < _sinkCount ? _sinks[id].frame : 0;
+}
+
+// Remove all sinks
+void clearSinks() {
+  for (uint8_t i = 0; i < _sinkCount; i++) {
+    delete[] _sinks[i].pending;
+    delete[] _sinks[i].acked;
+    delete[] _sinks[i].sent;
+  }
+  delete[] _sinks;
+  _sinks = nullptr;
+  _sinkCount = 0;
+}
+
+// Send a sink everything again, e.g. after its connection was reopened
+void resyncSink(uint8_t id) {
+  if (id >= _sinkCount) return;
+  qANSI_Sink &sink = _sinks[id];
+  if (sink.acked) {
+    _forgetCells(sink.acked);
+    sink.inFlight = false;
+    sink.cursorCol = 0xFF;
   } else {
-    _sendAnsiCommand("\033[?25l"); // Hide cursor
+    _markPending(sink.pending);
+  }
+}
+
+// True while a sink has cells or a cursor change that were not sent yet,
+// or for a state sync sink, not acknowledged yet
+bool isSinkPending(uint8_t id) const {
+  if (id >= _sinkCount) return false;
+  const qANSI_Sink &sink = _sinks[id];
+  if (_sinkCursorChanged(sink)) return true;
+  if (sink.acked) return sink.inFlight || _diffCells(sink.acked, nullptr);
+  for (size_t i = 0; i < _pendingSize(); i++) {
+    if (sink.pending[i]) return true;
+  }
+  return false;
+}
+
+// Bytes the most recent display() call sent to a sink
+uint32_t getSinkBytes(uint8_t id) const {
+  return id < _sinkCount ? _sinks[id].bytes : 0;
+}
+
+uint8_t getSinkCount() const {
+  return _sinkCount;
+}
+
+// --- Snapshots ---
+// A snapshot is a compact copy of the buffer, the cursor and the drawing
+// style in a caller-provided byte buffer: cells in reading order, the style
+// only where it changes and runs of identical cells as a count. Saving and
+// restoring use no heap and send nothing, so they can run in a reconnect
+// handler. Returns the bytes used, or 0 if the buffer is too small.
+size_t saveSnapshot(uint8_t *data, size_t size) const {
+  if (!_buffer) return 0;
+  size_t used = 0;
+  uint8_t flags = (isCursorVisible() ? SNAPSHOT_CURSOR_VISIBLE : 0) |
+                  (_lineWrappingEnabled ? SNAPSHOT_LINE_WRAPPING : 0) |
+                  (_scrollEnabled ? SNAPSHOT_SCROLLING : 0);
+  const uint8_t header[SNAPSHOT_HEADER] = {
+    'q', 'V', SNAPSHOT_VERSION, _width, _height, _posX, _posY, _cursorX, _cursorY, flags,
+    _currentFg, _currentBg, _currentAttr
+  };
+  for (uint8_t i = 0; i < SNAPSHOT_HEADER; i++) _putSnapshotByte(data, size, used, header[i]);
+  
+  // Cells start out in the default style
+  uint8_t fg = qANSI_Colors::FG_DEFAULT, bg = qANSI_Colors::BG_DEFAULT;
+  uint8_t attr = qANSI_Attributes::RESET;
+  for (uint8_t y = 1; y <= _height; y++) {
+    for (uint8_t x = 1; x <= _width; x++) {
+      uint16_t index = _getIndex(x, y);
+      const AnsiCell &cell = _buffer[index];
+      if (cell.fgColor != fg || cell.bgColor != bg || cell.attributes != attr) {
+        fg = cell.fgColor;
+        bg = cell.bgColor;
+        attr = cell.attributes;
+        _putSnapshotByte(data, size, used, SNAPSHOT_STYLE);
+        _putSnapshotByte(data, size, used, fg);
+        _putSnapshotByte(data, size, used, bg);
+        _putSnapshotByte(data, size, used, attr);
+      }
+      if ((uint8_t)cell.character < SNAPSHOT_TOKENS) _putSnapshotByte(data, size, used, SNAPSHOT_LITERAL);
+      _putSnapshotByte(data, size, used, cell.character);
+      
+      // Runs end at the end of the row
+      uint8_t n = 1;
+      while (x + n <= _width && _sameCell(cell, _buffer[index + n])) n++;
+      if (n > 2) {
+        _putSnapshotByte(data, size, used, SNAPSHOT_REPEAT);
+        _putSnapshotByte(data, size, used, n - 1);
+        x += n - 1;
+      }
+    }
+  }
+  return used <= size ? used : 0;
+}
+
+// Bytes saveSnapshot() needs for the current contents
+size_t getSnapshotSize() const {
+  return _buffer ? saveSnapshot(nullptr, (size_t)-1) : 0;
+}
+
+// Load a snapshot saved by a terminal of the same size. Cells that differ
+// are marked for the next display(), the position, cursor and style are
+// taken over. Returns false (and changes nothing) if the snapshot is
+// invalid or the size differs.
+bool restoreSnapshot(const uint8_t *data, size_t size) {
+  if (!_buffer || !checkSnapshot(data, size) || data[3] != _width || data[4] != _height) return false;
+  
+  size_t pos = SNAPSHOT_HEADER;
+  size_t cells = (size_t)_width * _height;
+  AnsiCell cell = { ' ', qANSI_Colors::FG_DEFAULT, qANSI_Colors::BG_DEFAULT,
+                    qANSI_Attributes::RESET, false };
+  uint8_t count;
+  _resolveRows();
+  for (size_t i = 0; i < cells; i += count) {
+    _readSnapshotCells(data, size, pos, cell, count);
+    for (uint8_t n = 0; n < count; n++) {
+      _storeCell(_buffer[i + n], cell.character, cell.fgColor, cell.bgColor, cell.attributes);
+    }
+  }
+  if (data[5] != _posX || data[6] != _posY) setPosition(data[5], data[6]);
+  _cursorX = data[7];
+  _cursorY = data[8];
+  _cursorVisible = (data[9] & SNAPSHOT_CURSOR_VISIBLE) != 0;
+  _lineWrappingEnabled = (data[9] & SNAPSHOT_LINE_WRAPPING) != 0;
+  _scrollEnabled = (data[9] & SNAPSHOT_SCROLLING) != 0;
+  _currentFg = data[10];
+  _currentBg = data[11];
+  _currentAttr = data[12];
+  return true;
+}
+
+// True if data holds a complete, well-formed snapshot
+static bool checkSnapshot(const uint8_t *data, size_t size) {
+  if (!data || size < SNAPSHOT_HEADER || data[0] != 'q' || data[1] != 'V' ||
+      data[2] != SNAPSHOT_VERSION) {
+    return false;
+  }
+  uint8_t width = data[3], height = data[4];
+  if (!width || !height || !data[5] || !data[6] || !data[7] || data[7] > width + 1 ||
+      !data[8] || data[8] > height + 1) {
+    return false;
+  }
+  size_t pos = SNAPSHOT_HEADER;
+  AnsiCell cell;
+  uint8_t count;
+  for (uint8_t y = 0; y < height; y++) {
+    for (uint16_t x = 0; x < width; x += count) {
+      if (!_readSnapshotCells(data, size, pos, cell, count) || x + count > width) return false;
+    }
+  }
+  return true;
+}
+
+// Paint a snapshot on a terminal in the fewest bytes, e.g. for a viewer that
+// attaches or a console that was reconnected. Each style change is one
+// combined SGR sequence, blank runs are erased (ECH) and with RUN_REPEAT
+// other runs are repeated (REP). The cursor ends up as in the snapshot.
+// Returns the bytes written, 0 if the snapshot is invalid.
+static size_t paintSnapshot(Print &out, const uint8_t *data, size_t size, uint8_t runModes = RUN_ERASE) {
+  if (!checkSnapshot(data, size)) return 0;
+  uint8_t width = data[3], height = data[4], posX = data[5], posY = data[6];
+  bool cursorVisible = (data[9] & SNAPSHOT_CURSOR_VISIBLE) != 0;
+  
+  size_t bytes = out.print(cursorVisible ? "\033[0m" : "\033[?25l\033[0m");
+  uint8_t fg = qANSI_Colors::FG_DEFAULT, bg = qANSI_Colors::BG_DEFAULT;
+  uint8_t attr = qANSI_Attributes::RESET;
+  size_t pos = SNAPSHOT_HEADER;
+  AnsiCell cell = { ' ', qANSI_Colors::FG_DEFAULT, qANSI_Colors::BG_DEFAULT,
+                    qANSI_Attributes::RESET, false };
+  uint8_t count;
+  char buf[24];
+  for (uint8_t y = 1; y <= height; y++) {
+    // At the left edge of the screen the next row is a CR LF away
+    if (y > 1 && posX == 1) {
+      bytes += out.print("\r\n");
+    } else {
+      bytes += _printCursor(out, posX, posY + y - 1);
+    }
+    uint8_t skip = 0;   // Cells erased ahead of the cursor
+    for (uint16_t x = 1; x <= width; x += count) {
+      _readSnapshotCells(data, size, pos, cell, count);
+      bool last = x + count > width;
+      
+      // Attributes only switch off with SGR 0, which also resets the colors
+      if (cell.attributes != attr || cell.fgColor != fg || cell.bgColor != bg) {
+        char *p = buf + sprintf(buf, "\033[");
+        if (cell.attributes != attr && attr != qANSI_Attributes::RESET) {
+          p += sprintf(p, "0;");
+          attr = qANSI_Attributes::RESET;
+          fg = qANSI_Colors::FG_DEFAULT;
+          bg = qANSI_Colors::BG_DEFAULT;
+        }
+        if (cell.attributes != attr) p += sprintf(p, "%d;", cell.attributes);
+        if (cell.fgColor != fg) p += sprintf(p, "%d;", cell.fgColor);
+        if (cell.bgColor != bg) p += sprintf(p, "%d;", cell.bgColor);
+        p[-1] = 'm';
+        bytes += out.print(buf);
+        attr = cell.attributes;
+        fg = cell.fgColor;
+        bg = cell.bgColor;
+      }
+      
+      // The cursor stays at the start of an erased run, a cell drawn after
+      // it needs a cursor move (CUF)
+      if (skip) {
+        sprintf(buf, "\033[%dC", skip);
+        bytes += out.print(buf);
+        skip = 0;
+      }
+      bool blank = _runMode(cell) == RUN_ERASE;
+      uint8_t eraseCost = 3 + _digitCount(count) + (last ? 0 : 3 + _digitCount(count));
+      if (blank && (runModes & RUN_ERASE) && eraseCost < count) {
+        sprintf(buf, "\033[%dX", count);
+        bytes += out.print(buf);
+        skip = count;
+        continue;
+      }
+      if (!blank && (runModes & RUN_REPEAT) && 4 + _digitCount(count - 1) < count) {
+        bytes += out.write((uint8_t)cell.character);
+        sprintf(buf, "\033[%db", count - 1);
+        bytes += out.print(buf);
+      } else {
+        for (uint8_t n = 0; n < count; n++) bytes += out.write((uint8_t)cell.character);
+      }
+    }
+  }
+  
+  if (cursorVisible) {
+    // The cursor may be left past the last column (pending wrap) or, without
+    // scrolling, below the last row
+    bytes += _printCursor(out, posX + min(data[7], width) - 1, posY + min(data[8], height) - 1);
+    bytes += out.print("\033[?25h");
+  }
+  return bytes;
+}
+
+#if QANSI_ENABLE_STATS
+// --- Rendering Statistics ---
+// Statistics of the most recently completed frame
+const qANSI_FrameStats &getFrameStats() const {
+  return _lastFrameStats;
+}
+
+// Totals over all frames since construction or resetRenderTotals()
+const qANSI_RenderTotals &getRenderTotals() const {
+  return _totals;
+}
+
+void resetRenderTotals() {
+  memset(&_totals, 0, sizeof(_totals));
+}
+#endif
+
+// --- Priority Regions ---
+// Dirty cells inside a region are sent before the rest of the frame, highest
+// priority first. A region that has waited longer than maxStaleMs is promoted
+// above all regions that are still within their limit (oldest first), so low
+// priority regions are not starved. Returns the region id, or -1 if the
+// region table is full or the rectangle lies outside the terminal.
+int8_t addRegion(uint8_t col, uint8_t row, uint8_t w, uint8_t h,
+                 uint8_t priority, uint16_t maxStaleMs = 0) {
+  if (!_buffer || col < 1 || col > _width || row < 1 || row > _height || w == 0 || h == 0) {
+    return -1;
+  }
+  if (!_regions) {
+    _regions = new qANSI_Region[QANSI_MAX_REGIONS];
+    if (!_regions) return -1;
+  }
+  if (_regionCount >= QANSI_MAX_REGIONS) return -1;
+  
+  qANSI_Region &region = _regions[_regionCount];
+  region.col = col;
+  region.row = row;
+  region.width = min(w, (uint8_t)(_width - col + 1));   // Clip to terminal
+  region.height = min(h, (uint8_t)(_height - row + 1));
+  region.priority = priority;
+  region.maxStaleMs = maxStaleMs;
+  region.pending = false;
+  region.dirtySince = 0;
+  memset(&region.stats, 0, sizeof(region.stats));
+  
+  return _regionCount++;
+}
+
+// Remove all priority regions
+void clearRegions() {
+  _regionCount = 0;
+}
+
+uint8_t getRegionCount() const {
+  return _regionCount;
+}
+
+// Update latency statistics of a region (all zero for an unknown id)
+const qANSI_RegionStats &getRegionStats(uint8_t id) const {
+  static const qANSI_RegionStats empty = {0, 0, 0, 0, 0};
+  return (id < _regionCount) ? _regions[id].stats : empty;
+}
+
+void resetRegionStats() {
+  for (uint8_t i = 0; i < _regionCount; i++) {
+    memset(&_regions[i].stats, 0, sizeof(_regions[i].stats));
+  }
+}
+
+// Priority of the whole terminal, used by displayByPriority()
+void setPriority(uint8_t priority, uint16_t maxStaleMs = 0) {
+  _priority = priority;
+  _priorityMaxStaleMs = maxStaleMs;
+}
+
+uint8_t getPriority() const {
+  return _priority;
+}
+
+// Share one budget between several terminals on the same link. Terminals with
+// pending output are served highest priority first, with the same aging rule
+// as regions. Returns true once every terminal has completed its frame. At
+// most 32 terminals are handled; any after the 32nd are left out.
+static bool displayByPriority(qANSI_VT *const *terminals, uint8_t count,
+                              const qANSI_Budget &budget = qANSI_Budget()) {
+  uint32_t now = millis();
+  uint32_t start = micros();
+  uint32_t bytesLeft = budget.maxBytes;
+  uint32_t served = 0;  // One bit per terminal
+  bool allComplete = true;
+  
+  if (count > 32) count = 32;
+  for (uint8_t i = 0; i < count; i++) {
+    if (!terminals[i]->_notePending(now)) served |= (uint32_t)1 << i;
+  }
+  
+  for (;;) {
+    // Pick the most urgent terminal that has not been served yet
+    int8_t next = -1;
+    for (uint8_t i = 0; i < count; i++) {
+      if (served & ((uint32_t)1 << i)) continue;
+      if (next < 0 || _servedBefore(terminals[i]->_priority, terminals[i]->_priorityMaxStaleMs,
+                                    terminals[i]->_pendingSince,
+                                    terminals[next]->_priority, terminals[next]->_priorityMaxStaleMs,
+                                    terminals[next]->_pendingSince, now)) {
+        next = i;
+      }
+    }
+    if (next < 0) break;
+    served |= (uint32_t)1 << next;
+    
+    // Hand the remaining budget to this terminal
+    qANSI_Budget remaining = budget;
+    if (budget.maxBytes) {
+      if (bytesLeft == 0) { allComplete = false; break; }
+      remaining.maxBytes = bytesLeft;
+    }
+    if (budget.maxMicros) {
+      uint32_t elapsed = micros() - start;
+      if (elapsed >= budget.maxMicros) { allComplete = false; break; }
+      remaining.maxMicros = budget.maxMicros - elapsed;
+    }
+    
+    qANSI_VT *vt = terminals[next];
+    if (!vt->display(remaining)) allComplete = false;
+    if (!vt->_frameActive) vt->_pendingSince = 0;
+    if (budget.maxBytes) bytesLeft -= min(bytesLeft, vt->_budgetBytes);
+  }
+  
+  return allComplete;
+}
+
+// --- Bound Data Fields ---
+// A field shows a number at a fixed place: format.width cells (at least 1)
+// from col,row, in the style that is current when the field is added. A
+// number that does not fit is shown as '*'s. bindField() ties a field to a
+// variable or a getter function, addField() makes one that is only updated
+// with setField(). Both return the field id, or -1 if the field table is
+// full or the field lies outside the terminal.
+int8_t bindField(uint8_t col, uint8_t row, const int *value, const qANSI_NumberFormat &format) {
+  int8_t id = value ? _addField(col, row, qANSI_Field::INT, format) : -1;
+  if (id >= 0) _fields[id].from.i = value;
+  return id;
+}
+
+int8_t bindField(uint8_t col, uint8_t row, const unsigned int *value, const qANSI_NumberFormat &format) {
+  int8_t id = value ? _addField(col, row, qANSI_Field::UINT, format) : -1;
+  if (id >= 0) _fields[id].from.ui = value;
+  return id;
+}
+
+int8_t bindField(uint8_t col, uint8_t row, const long *value, const qANSI_NumberFormat &format) {
+  int8_t id = value ? _addField(col, row, qANSI_Field::LONG, format) : -1;
+  if (id >= 0) _fields[id].from.l = value;
+  return id;
+}
+
+int8_t bindField(uint8_t col, uint8_t row, const unsigned long *value, const qANSI_NumberFormat &format) {
+  int8_t id = value ? _addField(col, row, qANSI_Field::ULONG, format) : -1;
+  if (id >= 0) _fields[id].from.ul = value;
+  return id;
+}
+
+int8_t bindField(uint8_t col, uint8_t row, const float *value, const qANSI_NumberFormat &format) {
+  int8_t id = value ? _addField(col, row, qANSI_Field::FLOAT, format) : -1;
+  if (id >= 0) _fields[id].from.f = value;
+  return id;
+}
+
+int8_t bindField(uint8_t col, uint8_t row, const double *value, const qANSI_NumberFormat &format) {
+  int8_t id = value ? _addField(col, row, qANSI_Field::DOUBLE, format) : -1;
+  if (id >= 0) _fields[id].from.d = value;
+  return id;
+}
+
+int8_t bindField(uint8_t col, uint8_t row, long (*getter)(), const qANSI_NumberFormat &format) {
+  int8_t id = getter ? _addField(col, row, qANSI_Field::LONG_FUNCTION, format) : -1;
+  if (id >= 0) _fields[id].from.lf = getter;
+  return id;
+}
+
+int8_t bindField(uint8_t col, uint8_t row, double (*getter)(), const qANSI_NumberFormat &format) {
+  int8_t id = getter ? _addField(col, row, qANSI_Field::DOUBLE_FUNCTION, format) : -1;
+  if (id >= 0) _fields[id].from.df = getter;
+  return id;
+}
+
+// A field without a source; it shows 0 until the first setField()
+int8_t addField(uint8_t col, uint8_t row, const qANSI_NumberFormat &format) {
+  return _addField(col, row, qANSI_Field::SET, format);
+}
+
+// Store a new value; the cells are updated right away if it differs from
+// the value shown. Returns true if it did. A bound field shows its source
+// again once that changes.
+bool setField(uint8_t id, long value) {
+  qANSI_FieldValue v;
+  memset(&v, 0, sizeof(v));
+  v.l = value;
+  return _setField(id, qANSI_Field::SIGNED, v);
+}
+
+bool setField(uint8_t id, unsigned long value) {
+  qANSI_FieldValue v;
+  memset(&v, 0, sizeof(v));
+  v.ul = value;
+  return _setField(id, qANSI_Field::UNSIGNED, v);
+}
+
+bool setField(uint8_t id, int value) {
+  return setField(id, (long)value);
+}
+
+bool setField(uint8_t id, unsigned int value) {
+  return setField(id, (unsigned long)value);
+}
+
+bool setField(uint8_t id, double value) {
+  qANSI_FieldValue v;
+  memset(&v, 0, sizeof(v));
+  v.d = value;
+  return _setField(id, qANSI_Field::REAL, v);
+}
+
+// Read every bound source and redraw the fields whose value changed. Only
+// changed fields are formatted and only cells whose character differs are
+// marked dirty, so a counter going from 1234 to 1235 sends one cell; an
+// unchanged field costs one comparison. Returns the number of fields redrawn.
+uint8_t refreshFields() {
+  uint8_t redrawn = 0;
+  for (uint8_t i = 0; i < _fieldCount; i++) {
+    qANSI_Field &field = _fields[i];
+    qANSI_FieldValue value = _readField(field);
+    // setField() may have stored another kind; a bound source brings its own back
+    uint8_t kind = field.source == qANSI_Field::SET ? field.kind : _sourceKind(field.source);
+    if (field.valid && field.kind == kind && memcmp(&value, &field.value, sizeof(value)) == 0) continue;
+    field.kind = kind;
+    field.value = value;
+    _drawField(field);
+    redrawn++;
+  }
+  return redrawn;
+}
+
+// Draw every field again on the next refreshFields(), e.g. after other
+// output overwrote them (clear() does this)
+void invalidateFields() {
+  for (uint8_t i = 0; i < _fieldCount; i++) {
+    _fields[i].valid = false;
   }
 }
 
+// Remove all fields (their cells keep the last values drawn)
+void clearFields() {
+  _fieldCount = 0;
+}
+
+uint8_t getFieldCount() const {
+  return _fieldCount;
+}
+
 // Helper method to update cell appearance (refactored for code reuse)
 void _updateCellAppearance(uint16_t index) {
-  // Update attributes if needed
+  // Update attributes if needed. Attributes only switch off with SGR 0,
+  // which also resets the colors.
   if (_buffer[index].attributes != _terminalAttr) {
-    setTextAttribute(_buffer[index].attributes);
-    _terminalAttr = _buffer[index].attributes;
+    if (_terminalAttr != qANSI_Attributes::RESET) {
+      _emitSgr(qANSI_Attributes::RESET);
+      _terminalAttr = qANSI_Attributes::RESET;
+      _terminalFg = qANSI_Colors::FG_DEFAULT;
+      _terminalBg = qANSI_Colors::BG_DEFAULT;
+    }
+    if (_buffer[index].attributes != qANSI_Attributes::RESET) {
+      _emitSgr(_buffer[index].attributes);
+      _terminalAttr = _buffer[index].attributes;
+    }
   }
   
   // Update foreground color if needed
   if (_buffer[index].fgColor != _terminalFg) {
-    setTextColor(_buffer[index].fgColor);
+    _emitSgr(_buffer[index].fgColor);
     _terminalFg = _buffer[index].fgColor;
   }
   
   // Update background color if needed
   if (_buffer[index].bgColor != _terminalBg) {
-    setTextBackgroundColor(_buffer[index].bgColor);
+    _emitSgr(_buffer[index].bgColor);
     _terminalBg = _buffer[index].bgColor;
   }
 }
-
   // --- Get Dimensions ---
   uint8_t width() const { return _width; }
   uint8_t height() const { return _height; }
@@ -766,6 +2162,16 @@ private:
 
   // --- The Virtual Screen Buffer ---
   AnsiCell *_buffer; // Dynamically allocated 1D array representing 2D grid
+  AnsiCell *_front;  // Cells last sent to the own output, see enableFrontBuffer()
+  
+  // --- Deferred Clear ---
+  // A row whose epoch differs from _clearEpoch was cleared after it was last
+  // touched: its cells are blanks in the clear style (all dirty)
+  uint8_t *_rowEpoch;
+  uint8_t _clearEpoch;
+  uint8_t _clearFg;
+  uint8_t _clearBg;
+  uint8_t _clearAttr;
 
   // --- Cursor and Attribute State for Drawing INTO the Buffer ---
   uint8_t _cursorX;
@@ -782,15 +2188,1296 @@ private:
   bool _lineWrappingEnabled; // Flag to control line wrapping behavior
   bool _forceFullRedraw;    // Flag to force a full redraw of the terminal
 
+  // --- Incoming Escape Sequence Parser State ---
+  enum {
+    ANSI_GROUND, ANSI_ESCAPE, ANSI_ESC_INT, ANSI_CSI_ENTRY,
+    ANSI_CSI_PARAM, ANSI_CSI_INT, ANSI_CSI_IGNORE, ANSI_STRING
+  };
+  bool _ansiParsingEnabled;
+  uint8_t _ansiState;
+  uint16_t _ansiParams[QANSI_ANSI_MAX_PARAMS];
+  uint8_t _ansiParamCount;  // QANSI_ANSI_MAX_PARAMS + 1 once parameters were dropped
+  uint32_t _ansiSubParams;  // Bit i: parameter i had ':' sub-parameters
+  uint8_t _ansiPrivate;     // Private marker ('?', '>', ...) or 0
+  uint8_t _ansiIntermediate; // Intermediate byte, 0 if none, 0xFF if several
+  uint8_t _ansiSavedX;      // Cursor saved by ESC 7 / CSI s
+  uint8_t _ansiSavedY;
+
+  // --- Priority Scheduling ---
+  qANSI_Region *_regions;   // Allocated on first addRegion()
+  uint8_t _regionCount;
+  uint8_t _priority;        // Priority of the whole terminal
+  uint16_t _priorityMaxStaleMs;
+  uint32_t _pendingSince;   // millis() when pending output was first seen (0 = none)
+
+  // --- Bound Data Fields ---
+  qANSI_Field *_fields;     // Allocated on first bindField()/addField()
+  uint8_t _fieldCount;
+  
+  uint8_t _runModes;        // RUN_ERASE / RUN_REPEAT sequences display() may use
+  
+  // --- Additional Output Streams ---
+  qANSI_Sink *_sinks;       // Allocated by the first addSink()
+  uint8_t _sinkCount;
+  uint8_t *_sinkPending;    // Bitmap of the sink being drawn, nullptr for the own output
+  AnsiCell *_sinkSent;      // Frame in flight of the state sync sink being drawn
+  Stream *_target;          // Stream the renderer writes to
+
+  // --- Frame State (lets a budget-limited display() resume a frame) ---
+  enum { FRAME_FULL, FRAME_SPARSE, FRAME_ROWS };
+  bool _frameActive;        // A frame has been started but not completed
+  uint8_t _frameStrategy;   // Strategy chosen when the frame was started
+  uint8_t _frameRow;        // Next buffer row to draw (1-based)
+  uint8_t _frameCol;        // Next buffer column to draw (1-based)
+
+  // --- Output Budget of the current display() call ---
+  uint32_t _budgetBytes;    // Bytes sent so far
+  uint32_t _budgetLimit;    // Byte limit for this call
+  uint16_t _budgetReserve;  // Bytes kept back for the epilogue
+  uint32_t _budgetStart;    // micros() when the call started
+  uint32_t _budgetMicros;   // Time limit for this call (0 = none)
+
+#if QANSI_ENABLE_STATS
+  // --- Rendering Statistics ---
+  qANSI_FrameStats _frameStats;     // Frame in progress
+  qANSI_FrameStats _lastFrameStats; // Last completed frame
+  qANSI_RenderTotals _totals;
+  uint8_t _redrawReason;            // Why the pending full redraw was requested
+
+  // The first request since the last full redraw determines the reason
+  void _noteRedraw(uint8_t reason) {
+    if (_redrawReason == qANSI_FrameStats::NOT_FULL) _redrawReason = reason;
+  }
+
+  void _beginFrameStats(uint16_t dirtyCells) {
+    memset(&_frameStats, 0, sizeof(_frameStats));
+    _frameStats.strategy = _frameStrategy + 1; // FRAME_* order matches
+    _frameStats.dirtyCells = dirtyCells;
+    if (_frameStrategy == FRAME_FULL) {
+      _frameStats.fullRedrawReason = _redrawReason ? _redrawReason : qANSI_FrameStats::FORCED;
+    }
+    _redrawReason = qANSI_FrameStats::NOT_FULL;
+  }
+
+  void _endFrameStats(bool complete) {
+    _frameStats.calls++;
+    _frameStats.micros += micros() - _budgetStart;
+    if (!complete) return;
+    
+    _lastFrameStats = _frameStats;
+    _totals.frames++;
+    if (_frameStats.fullRedrawReason) _totals.fullRedraws[_frameStats.fullRedrawReason]++;
+    _totals.dirtyCells += _frameStats.dirtyCells;
+    _totals.cellsEmitted += _frameStats.cellsEmitted;
+    for (uint8_t i = 0; i < qANSI_FrameStats::CATEGORIES; i++) {
+      _totals.bytes[i] += _frameStats.bytes[i];
+    }
+    _totals.escapes += _frameStats.escapes;
+    _totals.micros += _frameStats.micros;
+  }
+#endif
+
   // --- Helper function to get buffer index ---
-  // Converts 1-based screen coordinates to 0-based buffer index.
+  // Converts 1-based screen coordinates to 0-based buffer index. A row that
+  // was cleared since it was last touched is filled first, so every access
+  // through the index sees the current contents.
   inline uint16_t _getIndex(uint8_t col, uint8_t row) const {
     // Ensure coordinates are within bounds
     col = constrain(col, (uint8_t)1, _width);
     row = constrain(row, (uint8_t)1, _height);
     
+    if (_rowEpoch[row - 1] != _clearEpoch) _resolveRow(row);
     return (row - 1) * _width + (col - 1);
   }
+  
+  // --- Deferred Clear Helpers ---
+  // Fill a stale row with blanks in the clear style. Only the buffer behind
+  // the pointers changes, and the contents seen through it stay the same,
+  // so const readers may do it as well.
+  void _resolveRow(uint8_t row) const {
+    AnsiCell *cell = _buffer + (size_t)(row - 1) * _width;
+    for (uint8_t x = 0; x < _width; x++) {
+      cell[x].character = ' ';
+      cell[x].fgColor = _clearFg;
+      cell[x].bgColor = _clearBg;
+      cell[x].attributes = _clearAttr;
+      cell[x].dirty = true;
+    }
+    _rowEpoch[row - 1] = _clearEpoch;
+  }
+  
+  // Before a loop over the raw buffer
+  void _resolveRows() const {
+    for (uint8_t y = 1; y <= _height; y++) {
+      if (_rowEpoch[y - 1] != _clearEpoch) _resolveRow(y);
+    }
+  }
+  
+  // Stale rows count as changed
+  bool _hasStaleRows() const {
+    for (uint8_t y = 0; y < _height; y++) {
+      if (_rowEpoch[y] != _clearEpoch) return true;
+    }
+    return false;
+  }
+
+  // --- Front Buffer Helpers ---
+  // Set the dirty flags of a new frame from a compare against the front
+  // buffer. A block of cells spans a whole number of words (or SSE2
+  // vectors); it is compared with the dirty bytes masked out, and only a
+  // block that differs or still has flags set is looked at cell by cell.
+  // Returns false if no cell has to be sent.
+  bool _diffFront() {
+    _resolveRows();
+    const size_t cells = (size_t)_width * _height;
+    size_t i = 0;
+    bool any = false;
+    
+#if defined(__SSE2__)
+    uint8_t wideMask[sizeof(AnsiCell) * 16];
+    _contentMask(wideMask, sizeof(wideMask));
+    __m128i wideContent[sizeof(AnsiCell)];
+    for (uint8_t k = 0; k < sizeof(AnsiCell); k++) {
+      wideContent[k] = _mm_loadu_si128((const __m128i *)(wideMask + k * 16));
+    }
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= cells; i += 16) {
+      const uint8_t *a = (const uint8_t *)(_buffer + i);
+      const uint8_t *b = (const uint8_t *)(_front + i);
+      __m128i changed = zero;
+      for (uint8_t k = 0; k < sizeof(AnsiCell); k++) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + k * 16));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + k * 16));
+        changed = _mm_or_si128(changed, _mm_and_si128(_mm_xor_si128(x, y), wideContent[k]));
+        changed = _mm_or_si128(changed, _mm_andnot_si128(wideContent[k], x));
+      }
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(changed, zero)) != 0xFFFF) any |= _markChanged(i, 16);
+    }
+#endif
+    
+    typedef uintptr_t Word;
+    uint8_t mask[sizeof(AnsiCell) * sizeof(Word)];
+    _contentMask(mask, sizeof(mask));
+    Word content[sizeof(AnsiCell)];
+    memcpy(content, mask, sizeof(content));
+    for (; i + sizeof(Word) <= cells; i += sizeof(Word)) {
+      const uint8_t *a = (const uint8_t *)(_buffer + i);
+      const uint8_t *b = (const uint8_t *)(_front + i);
+      Word changed = 0;
+      for (uint8_t k = 0; k < sizeof(AnsiCell); k++) {
+        Word x, y;
+        memcpy(&x, a + k * sizeof(Word), sizeof(Word));
+        memcpy(&y, b + k * sizeof(Word), sizeof(Word));
+        changed |= ((x ^ y) & content[k]) | (x & ~content[k]);
+      }
+      if (changed) any |= _markChanged(i, sizeof(Word));
+    }
+    
+    any |= _markChanged(i, cells - i);
+    return any;
+  }
+  
+  // Bytes of a block of cells: 0xFF over the contents, 0 over the dirty flag
+  // (the last byte of a cell)
+  static void _contentMask(uint8_t *mask, uint8_t size) {
+    for (uint8_t i = 0; i < size; i++) {
+      mask[i] = (i % sizeof(AnsiCell) == sizeof(AnsiCell) - 1) ? 0 : 0xFF;
+    }
+  }
+  
+  // Returns true if a cell differs
+  bool _markChanged(size_t index, size_t count) {
+    bool any = false;
+    for (; count > 0; count--, index++) {
+      _buffer[index].dirty = !_sameCell(_buffer[index], _front[index]);
+      any |= _buffer[index].dirty;
+    }
+    return any;
+  }
+
+  // --- Priority Region Helpers ---
+  bool _inRegion(uint8_t x, uint8_t y) const {
+    for (uint8_t i = 0; i < _regionCount; i++) {
+      const qANSI_Region &r = _regions[i];
+      if (x >= r.col && x < r.col + r.width && y >= r.row && y < r.row + r.height) return true;
+    }
+    return false;
+  }
+
+  bool _regionHasDirty(const qANSI_Region &r) const {
+    for (uint8_t y = r.row; y < r.row + r.height; y++) {
+      for (uint8_t x = r.col; x < r.col + r.width; x++) {
+        if (_buffer[_getIndex(x, y)].dirty) return true;
+      }
+    }
+    return false;
+  }
+
+  // Ordering used for both regions and whole terminals: overdue entries first
+  // (oldest first), then by priority
+  static bool _servedBefore(uint8_t prioA, uint16_t staleA, uint32_t sinceA,
+                            uint8_t prioB, uint16_t staleB, uint32_t sinceB, uint32_t now) {
+    bool overdueA = staleA && (now - sinceA) >= staleA;
+    bool overdueB = staleB && (now - sinceB) >= staleB;
+    if (overdueA != overdueB) return overdueA;
+    if (overdueA) return (now - sinceA) > (now - sinceB);
+    return prioA > prioB;
+  }
+
+  // Start the latency clock of regions that have become dirty
+  void _observeRegions() {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < _regionCount; i++) {
+      qANSI_Region &r = _regions[i];
+      if (!r.pending && _regionHasDirty(r)) {
+        r.pending = true;
+        r.dirtySince = now;
+      }
+    }
+  }
+
+  // Send dirty region cells in scheduling order
+  bool _drawRegions() {
+    uint32_t now = millis();
+    uint8_t order[QANSI_MAX_REGIONS];
+    uint8_t count = 0;
+    
+    // Insertion sort of the pending regions
+    for (uint8_t i = 0; i < _regionCount; i++) {
+      if (!_regions[i].pending) continue;
+      uint8_t pos = count++;
+      while (pos > 0) {
+        const qANSI_Region &a = _regions[i];
+        const qANSI_Region &b = _regions[order[pos - 1]];
+        if (!_servedBefore(a.priority, a.maxStaleMs, a.dirtySince,
+                           b.priority, b.maxStaleMs, b.dirtySince, now)) break;
+        order[pos] = order[pos - 1];
+        pos--;
+      }
+      order[pos] = i;
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+      const qANSI_Region &r = _regions[order[i]];
+      for (uint8_t y = r.row; y < r.row + r.height; y++) {
+        for (uint8_t x = r.col; x < r.col + r.width; x++) {
+          if (_buffer[_getIndex(x, y)].dirty && !_drawCell(x, y)) return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Record latency of regions whose changes have all been sent
+  void _retireRegions() {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < _regionCount; i++) {
+      qANSI_Region &r = _regions[i];
+      if (!r.pending || _regionHasDirty(r)) continue;
+      
+      uint32_t latency = now - r.dirtySince;
+      r.stats.updates++;
+      r.stats.lastLatency = latency;
+      r.stats.totalLatency += latency;
+      if (latency > r.stats.maxLatency) r.stats.maxLatency = latency;
+      if (r.maxStaleMs && latency > r.maxStaleMs) r.stats.missedTargets++;
+      r.pending = false;
+    }
+  }
+
+  // Start the staleness clock if the terminal has output pending.
+  // Returns false if there is nothing to send.
+  bool _notePending(uint32_t now) {
+    bool pending = _frameActive || _forceFullRedraw || (_buffer && _hasStaleRows());
+    if (!pending && _buffer) {
+      size_t bufferSize = (size_t)_width * _height;
+      for (size_t i = 0; i < bufferSize && !pending; ++i) {
+        pending = _buffer[i].dirty;
+      }
+    }
+    if (!pending) {
+      _pendingSince = 0;
+    } else if (_pendingSince == 0) {
+      _pendingSince = now ? now : 1;
+    }
+    return pending;
+  }
+
+  // --- Pipe Code Helpers ---
+  // Update the drawing style for a pipe code; user table codes may also
+  // write macro text into the buffer
+  size_t _decodePipeCode(char c1, char c2) {
+    const qANSI_PipeTable::Entry *entry = _pipeTable ? _pipeTable->find(c1, c2) : nullptr;
+    if (entry) {
+      const uint8_t *ops = _pipeTable->ops(*entry);
+      for (uint8_t i = 0; i < entry->opsLength; i++) {
+        if (ops[i] == qANSI_PipeTable::OP_STYLE && i + 1 < entry->opsLength) {
+          _applySgrState(ops[++i]);
+        } else {
+          _putChar(ops[i]);
+        }
+      }
+      return 3;
+    }
+    
+    uint8_t sgr = qANSI_PipeTable::builtinSgr(c1, c2);
+    if (sgr == 0xFF) {
+      // Not a supported code, store the original sequence
+      _putChar('|');
+      _putChar(c1);
+      return _putChar(c2) + 2;
+    }
+    _applySgrState(sgr);
+    return 3;
+  }
+
+  // --- Incoming Escape Sequence Parser ---
+  // Table-driven state machine after Paul Williams' DEC VT500 parser. The
+  // OSC/DCS/SOS/PM/APC states are collapsed into one string state, since
+  // their contents are dropped.
+  enum {
+    ANSI_CLASS_C0, ANSI_CLASS_BEL, ANSI_CLASS_CANCEL, ANSI_CLASS_ESC,
+    ANSI_CLASS_INTER, ANSI_CLASS_DIGIT, ANSI_CLASS_SEP, ANSI_CLASS_PRIV,
+    ANSI_CLASS_CSI, ANSI_CLASS_STRING, ANSI_CLASS_FINAL, ANSI_CLASS_DEL,
+    ANSI_CLASS_HIGH, ANSI_CLASS_COUNT
+  };
+  enum {
+    ANSI_NONE, ANSI_PRINT, ANSI_EXECUTE, ANSI_CLEAR, ANSI_COLLECT,
+    ANSI_PARAM, ANSI_ESC_DISPATCH, ANSI_CSI_DISPATCH
+  };
+
+  static uint8_t _ansiClass(uint8_t c) {
+    if (c >= 0x80) return ANSI_CLASS_HIGH;
+    if (c >= 0x40) {
+      if (c == '[') return ANSI_CLASS_CSI;
+      if (c == 'P' || c == 'X' || c == ']' || c == '^' || c == '_') return ANSI_CLASS_STRING;
+      return c == 0x7F ? ANSI_CLASS_DEL : ANSI_CLASS_FINAL;
+    }
+    if (c >= 0x3C) return ANSI_CLASS_PRIV;
+    if (c >= 0x3A) return ANSI_CLASS_SEP;  // ':' (sub-parameter) or ';'
+    if (c >= 0x30) return ANSI_CLASS_DIGIT;
+    if (c >= 0x20) return ANSI_CLASS_INTER;
+    if (c == 0x1B) return ANSI_CLASS_ESC;
+    if (c == 0x18 || c == 0x1A) return ANSI_CLASS_CANCEL;
+    return c == 0x07 ? ANSI_CLASS_BEL : ANSI_CLASS_C0;
+  }
+
+  // Transition for a state and byte class: (action << 4) | next state
+  static uint8_t _ansiTransition(uint8_t state, uint8_t byteClass) {
+    #define QANSI_T(action, next) (uint8_t)((ANSI_##action << 4) | ANSI_##next)
+    static const uint8_t table[8][ANSI_CLASS_COUNT] PROGMEM = {
+      { // GROUND
+        QANSI_T(EXECUTE, GROUND), QANSI_T(EXECUTE, GROUND), QANSI_T(NONE, GROUND),
+        QANSI_T(CLEAR, ESCAPE), QANSI_T(PRINT, GROUND), QANSI_T(PRINT, GROUND),
+        QANSI_T(PRINT, GROUND), QANSI_T(PRINT, GROUND), QANSI_T(PRINT, GROUND),
+        QANSI_T(PRINT, GROUND), QANSI_T(PRINT, GROUND), QANSI_T(NONE, GROUND),
+        QANSI_T(PRINT, GROUND)
+      },
+      { // ESCAPE
+        QANSI_T(EXECUTE, ESCAPE), QANSI_T(EXECUTE, ESCAPE), QANSI_T(NONE, GROUND),
+        QANSI_T(CLEAR, ESCAPE), QANSI_T(COLLECT, ESC_INT), QANSI_T(ESC_DISPATCH, GROUND),
+        QANSI_T(ESC_DISPATCH, GROUND), QANSI_T(ESC_DISPATCH, GROUND), QANSI_T(CLEAR, CSI_ENTRY),
+        QANSI_T(NONE, STRING), QANSI_T(ESC_DISPATCH, GROUND), QANSI_T(NONE, ESCAPE),
+        QANSI_T(NONE, GROUND)
+      },
+      { // ESC_INT
+        QANSI_T(EXECUTE, ESC_INT), QANSI_T(EXECUTE, ESC_INT), QANSI_T(NONE, GROUND),
+        QANSI_T(CLEAR, ESCAPE), QANSI_T(COLLECT, ESC_INT), QANSI_T(ESC_DISPATCH, GROUND),
+        QANSI_T(ESC_DISPATCH, GROUND), QANSI_T(ESC_DISPATCH, GROUND), QANSI_T(ESC_DISPATCH, GROUND),
+        QANSI_T(ESC_DISPATCH, GROUND), QANSI_T(ESC_DISPATCH, GROUND), QANSI_T(NONE, ESC_INT),
+        QANSI_T(NONE, GROUND)
+      },
+      { // CSI_ENTRY
+        QANSI_T(EXECUTE, CSI_ENTRY), QANSI_T(EXECUTE, CSI_ENTRY), QANSI_T(NONE, GROUND),
+        QANSI_T(CLEAR, ESCAPE), QANSI_T(COLLECT, CSI_INT), QANSI_T(PARAM, CSI_PARAM),
+        QANSI_T(PARAM, CSI_PARAM), QANSI_T(COLLECT, CSI_PARAM), QANSI_T(CSI_DISPATCH, GROUND),
+        QANSI_T(CSI_DISPATCH, GROUND), QANSI_T(CSI_DISPATCH, GROUND), QANSI_T(NONE, CSI_ENTRY),
+        QANSI_T(NONE, GROUND)
+      },
+      { // CSI_PARAM
+        QANSI_T(EXECUTE, CSI_PARAM), QANSI_T(EXECUTE, CSI_PARAM), QANSI_T(NONE, GROUND),
+        QANSI_T(CLEAR, ESCAPE), QANSI_T(COLLECT, CSI_INT), QANSI_T(PARAM, CSI_PARAM),
+        QANSI_T(PARAM, CSI_PARAM), QANSI_T(NONE, CSI_IGNORE), QANSI_T(CSI_DISPATCH, GROUND),
+        QANSI_T(CSI_DISPATCH, GROUND), QANSI_T(CSI_DISPATCH, GROUND), QANSI_T(NONE, CSI_PARAM),
+        QANSI_T(NONE, GROUND)
+      },
+      { // CSI_INT
+        QANSI_T(EXECUTE, CSI_INT), QANSI_T(EXECUTE, CSI_INT), QANSI_T(NONE, GROUND),
+        QANSI_T(CLEAR, ESCAPE), QANSI_T(COLLECT, CSI_INT), QANSI_T(NONE, CSI_IGNORE),
+        QANSI_T(NONE, CSI_IGNORE), QANSI_T(NONE, CSI_IGNORE), QANSI_T(CSI_DISPATCH, GROUND),
+        QANSI_T(CSI_DISPATCH, GROUND), QANSI_T(CSI_DISPATCH, GROUND), QANSI_T(NONE, CSI_INT),
+        QANSI_T(NONE, GROUND)
+      },
+      { // CSI_IGNORE
+        QANSI_T(EXECUTE, CSI_IGNORE), QANSI_T(EXECUTE, CSI_IGNORE), QANSI_T(NONE, GROUND),
+        QANSI_T(CLEAR, ESCAPE), QANSI_T(NONE, CSI_IGNORE), QANSI_T(NONE, CSI_IGNORE),
+        QANSI_T(NONE, CSI_IGNORE), QANSI_T(NONE, CSI_IGNORE), QANSI_T(NONE, GROUND),
+        QANSI_T(NONE, GROUND), QANSI_T(NONE, GROUND), QANSI_T(NONE, CSI_IGNORE),
+        QANSI_T(NONE, GROUND)
+      },
+      { // STRING (OSC, DCS, SOS, PM, APC), ended by BEL, CAN/SUB or ESC
+        QANSI_T(NONE, STRING), QANSI_T(NONE, GROUND), QANSI_T(NONE, GROUND),
+        QANSI_T(CLEAR, ESCAPE), QANSI_T(NONE, STRING), QANSI_T(NONE, STRING),
+        QANSI_T(NONE, STRING), QANSI_T(NONE, STRING), QANSI_T(NONE, STRING),
+        QANSI_T(NONE, STRING), QANSI_T(NONE, STRING), QANSI_T(NONE, STRING),
+        QANSI_T(NONE, STRING)
+      }
+    };
+    #undef QANSI_T
+    return pgm_read_byte(&table[state][byteClass]);
+  }
+
+  // Feed one byte to the parser
+  void _ansiInput(uint8_t c) {
+    uint8_t transition = _ansiTransition(_ansiState, _ansiClass(c));
+    _ansiState = transition & 0x0F;
+    
+    switch (transition >> 4) {
+      case ANSI_PRINT:
+      case ANSI_EXECUTE:
+        _putChar(c);
+        break;
+      case ANSI_CLEAR:
+        _ansiParams[0] = 0;
+        _ansiParamCount = 0;
+        _ansiSubParams = 0;
+        _ansiPrivate = 0;
+        _ansiIntermediate = 0;
+        break;
+      case ANSI_COLLECT:
+        if (c >= 0x3C) {
+          _ansiPrivate = c;
+        } else {
+          _ansiIntermediate = _ansiIntermediate ? 0xFF : c;
+        }
+        break;
+      case ANSI_PARAM:
+        if (_ansiParamCount == 0) _ansiParamCount = 1;
+        if (c == ':') {
+          // Sub-parameters belong to the current parameter, their values
+          // are dropped
+          if (_ansiParamCount <= 32) _ansiSubParams |= (uint32_t)1 << (_ansiParamCount - 1);
+        } else if (c >= '0' && c <= '9') {
+          if (_ansiParamCount <= QANSI_ANSI_MAX_PARAMS && !_ansiHasSubParams(_ansiParamCount - 1)) {
+            uint16_t &param = _ansiParams[_ansiParamCount - 1];
+            param = param < 6553 ? param * 10 + (c - '0') : 0xFFFF; // Saturate
+          }
+        } else if (_ansiParamCount <= QANSI_ANSI_MAX_PARAMS) {
+          if (_ansiParamCount < QANSI_ANSI_MAX_PARAMS) _ansiParams[_ansiParamCount] = 0;
+          _ansiParamCount++;
+        }
+        break;
+      case ANSI_ESC_DISPATCH:
+        _ansiEscDispatch(c);
+        break;
+      case ANSI_CSI_DISPATCH:
+        _ansiCsiDispatch(c);
+        break;
+    }
+  }
+
+  // Parameter i was followed by ':' sub-parameters
+  bool _ansiHasSubParams(uint8_t i) const {
+    return i < 32 && (_ansiSubParams & ((uint32_t)1 << i));
+  }
+
+  // Parameter i, or the default if it is missing or 0
+  uint16_t _ansiParam(uint8_t i, uint16_t defaultValue) const {
+    uint8_t count = _ansiParamCount < QANSI_ANSI_MAX_PARAMS ? _ansiParamCount : QANSI_ANSI_MAX_PARAMS;
+    return (i < count && _ansiParams[i]) ? _ansiParams[i] : defaultValue;
+  }
+
+  // Clamp a 1-based coordinate to 1..limit
+  static uint8_t _ansiClamp(int32_t value, uint8_t limit) {
+    return value < 1 ? 1 : (value > limit ? limit : (uint8_t)value);
+  }
+
+  // Cursor down one line, scrolling at the bottom (IND)
+  void _ansiIndex() {
+    if (_cursorY < _height) {
+      _cursorY++;
+    } else if (_scrollEnabled) {
+      scrollUp(1);
+      _cursorY = _height;
+    }
+  }
+
+  void _ansiEscDispatch(uint8_t final) {
+    if (_ansiIntermediate) return; // Character set selection etc. is ignored
+    switch (final) {
+      case '7': // DECSC
+        _ansiSavedX = _cursorX;
+        _ansiSavedY = _cursorY;
+        break;
+      case '8': // DECRC
+        _cursorX = _ansiClamp(_ansiSavedX, _width);
+        _cursorY = _ansiClamp(_ansiSavedY, _height);
+        break;
+      case 'E': // NEL
+        _cursorX = 1;
+        // Fall through
+      case 'D': // IND
+        _ansiIndex();
+        break;
+      case 'M': // RI
+        if (_cursorY > 1) {
+          _cursorY--;
+        } else if (_scrollEnabled) {
+          scrollDown(1);
+        }
+        break;
+      case 'c': // RIS
+        _applySgrState(qANSI_Attributes::RESET);
+        _lineWrappingEnabled = true;
+        clear(false);
+        break;
+    }
+  }
+
+  void _ansiCsiDispatch(uint8_t final) {
+    if (_ansiIntermediate) return;
+    if (_ansiPrivate) {
+      // DECSET/DECRST: cursor visibility and auto-wrap
+      if (_ansiPrivate == '?' && (final == 'h' || final == 'l')) {
+        uint8_t count = _ansiParamCount < QANSI_ANSI_MAX_PARAMS ? _ansiParamCount : QANSI_ANSI_MAX_PARAMS;
+        for (uint8_t i = 0; i < count; i++) {
+          if (_ansiParams[i] == 25) _cursorVisible = (final == 'h');
+          if (_ansiParams[i] == 7) _lineWrappingEnabled = (final == 'h');
+        }
+      }
+      return;
+    }
+    
+    uint16_t n = _ansiParam(0, 1);
+    uint8_t x = _ansiClamp(_cursorX, _width);
+    uint8_t y = _ansiClamp(_cursorY, _height);
+    switch (final) {
+      case 'm': _ansiSgr(); return;
+      case 'A': _cursorY = _ansiClamp((int32_t)y - n, _height); _cursorX = x; return;                 // CUU
+      case 'B': case 'e': _cursorY = _ansiClamp((int32_t)y + n, _height); _cursorX = x; return;      // CUD, VPR
+      case 'C': case 'a': _cursorX = _ansiClamp((int32_t)x + n, _width); _cursorY = y; return;       // CUF, HPR
+      case 'D': _cursorX = _ansiClamp((int32_t)x - n, _width); _cursorY = y; return;                 // CUB
+      case 'E': _cursorY = _ansiClamp((int32_t)y + n, _height); _cursorX = 1; return;                // CNL
+      case 'F': _cursorY = _ansiClamp((int32_t)y - n, _height); _cursorX = 1; return;                // CPL
+      case 'G': case '`': _cursorX = _ansiClamp(n, _width); _cursorY = y; return;                    // CHA, HPA
+      case 'd': _cursorY = _ansiClamp(n, _height); _cursorX = x; return;                             // VPA
+      case 'H': case 'f':                                                                            // CUP, HVP
+        _cursorY = _ansiClamp(n, _height);
+        _cursorX = _ansiClamp(_ansiParam(1, 1), _width);
+        return;
+      case 's': _ansiSavedX = x; _ansiSavedY = y; return;
+      case 'u':
+        _cursorX = _ansiClamp(_ansiSavedX, _width);
+        _cursorY = _ansiClamp(_ansiSavedY, _height);
+        return;
+      case 'S': scrollUp(n > _height ? _height : n); return;
+      case 'T': scrollDown(n > _height ? _height : n); return;
+    }
+    
+    // Erase and edit functions work on the (clamped) cursor position
+    _cursorX = x;
+    _cursorY = y;
+    if (n > _width && final != 'L' && final != 'M') n = _width;
+    switch (final) {
+      case 'J': // ED
+        switch (_ansiParam(0, 0)) {
+          case 0:
+            _eraseCells(y, y, x, _width);
+            if (y < _height) _eraseCells(y + 1, _height, 1, _width);
+            break;
+          case 1:
+            if (y > 1) _eraseCells(1, y - 1, 1, _width);
+            _eraseCells(y, y, 1, x);
+            break;
+          default:
+            _eraseCells(1, _height, 1, _width);
+            break;
+        }
+        break;
+      case 'K': // EL
+        switch (_ansiParam(0, 0)) {
+          case 0: _eraseCells(y, y, x, _width); break;
+          case 1: _eraseCells(y, y, 1, x); break;
+          default: _eraseCells(y, y, 1, _width); break;
+        }
+        break;
+      case 'X': // ECH
+        _eraseCells(y, y, x, x + n - 1 > _width ? _width : x + n - 1);
+        break;
+      case '@': // ICH
+        for (uint16_t col = _width; col >= x + n; col--) {
+          _copyCell(_getIndex(col, y), _getIndex(col - n, y));
+        }
+        _eraseCells(y, y, x, x + n - 1 > _width ? _width : x + n - 1);
+        break;
+      case 'P': // DCH
+        for (uint16_t col = x; col + n <= _width; col++) {
+          _copyCell(_getIndex(col, y), _getIndex(col + n, y));
+        }
+        _eraseCells(y, y, _width - n + 1 > x ? _width - n + 1 : x, _width);
+        break;
+      case 'L': // IL
+      case 'M': // DL
+        _ansiShiftLines(y, n > _height ? _height : n, final == 'L');
+        _cursorX = 1;
+        break;
+    }
+  }
+
+  // Insert (or delete) lines at row y, shifting the rows below it
+  void _ansiShiftLines(uint8_t y, uint8_t lines, bool insert) {
+    uint8_t span = _height - y + 1;
+    if (lines > span) lines = span;
+    if (insert) {
+      for (uint16_t row = _height; row >= y + lines; row--) {
+        for (uint16_t col = 1; col <= _width; col++) {
+          _copyCell(_getIndex(col, row), _getIndex(col, row - lines));
+        }
+      }
+      _eraseCells(y, y + lines - 1, 1, _width);
+    } else {
+      for (uint16_t row = y; row + lines <= _height; row++) {
+        for (uint16_t col = 1; col <= _width; col++) {
+          _copyCell(_getIndex(col, row), _getIndex(col, row + lines));
+        }
+      }
+      _eraseCells(_height - lines + 1, _height, 1, _width);
+    }
+  }
+
+  void _ansiSgr() {
+    uint8_t count = _ansiParamCount < QANSI_ANSI_MAX_PARAMS ? _ansiParamCount : QANSI_ANSI_MAX_PARAMS;
+    if (count == 0) {
+      _applySgrState(qANSI_Attributes::RESET);
+      return;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      uint16_t code = _ansiParams[i];
+      if (_ansiHasSubParams(i)) {
+        // Colon forms (38:2::r:g:b, 4:3 curly underline) carry values a
+        // cell can't hold, the whole parameter is skipped
+        continue;
+      }
+      if (code == 38 || code == 48 || code == 58) {
+        // 256-color and RGB colors (and underline colors) don't fit in a
+        // cell, skip their arguments
+        uint16_t mode = i + 1 < count ? _ansiParams[i + 1] : 0;
+        i += (mode == 5) ? 2 : (mode == 2) ? 4 : 1;
+      } else if (code >= 21 && code <= 29) {
+        // Cells hold a single attribute, so "off" only clears a matching one
+        uint8_t attr = _currentAttr;
+        if (attr == code - 20 || (code == 22 && attr == 1) || (code == 25 && attr == 6)) {
+          _currentAttr = qANSI_Attributes::RESET;
+        }
+      } else if (code <= 9 || (code >= 30 && code <= 49) ||
+                 (code >= 90 && code <= 97) || (code >= 100 && code <= 107)) {
+        _applySgrState(code);
+      }
+    }
+  }
+
+  // Copy a cell, marking it dirty only if it changes
+  void _copyCell(uint16_t dest, uint16_t src) {
+    AnsiCell &to = _buffer[dest];
+    const AnsiCell &from = _buffer[src];
+    if (to.character != from.character || to.fgColor != from.fgColor ||
+        to.bgColor != from.bgColor || to.attributes != from.attributes) {
+      to = from;
+      to.dirty = true;
+    }
+  }
+
+  // Erase a block of cells (rows y1..y2, columns x1..x2) with the current
+  // colors, marking only cells that change as dirty
+  void _eraseCells(uint8_t y1, uint8_t y2, uint8_t x1, uint8_t x2) {
+    uint8_t fg = getCurrentFgColor();
+    uint8_t bg = getCurrentBgColor();
+    for (uint16_t y = y1; y <= y2; y++) {
+      for (uint16_t x = x1; x <= x2; x++) {
+        _storeCell(_buffer[_getIndex(x, y)], ' ', fg, bg, qANSI_Attributes::RESET);
+      }
+    }
+  }
+
+  // Fill a block with one character in the current colors. Takes 16-bit
+  // coordinates so callers can pass edges beyond column 255; the block is
+  // clipped to the terminal.
+  void _fillRect(uint16_t col, uint16_t row, uint16_t w, uint16_t h, char c, uint8_t attr) {
+    if (!_buffer || col < 1 || row < 1 || col > _width || row > _height || w == 0 || h == 0) return;
+    uint8_t span = min(w, (uint16_t)(_width - col + 1));
+    uint8_t y2 = min((uint16_t)(row + h - 1), (uint16_t)_height);
+    uint8_t fg = getCurrentFgColor();
+    uint8_t bg = getCurrentBgColor();
+    for (uint16_t y = row; y <= y2; y++) {
+      AnsiCell *cell = &_buffer[_getIndex(col, y)];
+      for (uint8_t n = span; n; n--) _storeCell(*cell++, c, fg, bg, attr);
+    }
+  }
+
+  // Store a character and style in a cell, marking it dirty only if it
+  // changes. Returns true if it changed.
+  bool _storeCell(AnsiCell &cell, char c, uint8_t fg, uint8_t bg, uint8_t attr) {
+    if (cell.character != c || cell.fgColor != fg || cell.bgColor != bg || cell.attributes != attr) {
+      cell.character = c;
+      cell.fgColor = fg;
+      cell.bgColor = bg;
+      cell.attributes = attr;
+      cell.dirty = true;
+      return true;
+    }
+    return false;
+  }
+
+  // --- Sprite Helpers ---
+  // True if the shown sprite covers terminal cell x/y with an opaque cell
+  static bool _spriteOpaqueAt(const qANSI_Sprite &sprite, uint16_t x, uint16_t y) {
+    if (x < sprite.col || y < sprite.row || x >= sprite.col + sprite.width || y >= sprite.row + sprite.height) {
+      return false;
+    }
+    char c = sprite.image[(y - sprite.row) * sprite.width + (x - sprite.col)].character;
+    return !sprite.transparent || c != sprite.transparent;
+  }
+
+  // Put back the saved cells of a shown sprite, except those it will cover
+  // again at col/row (0/0: none)
+  uint16_t _restoreSprite(const qANSI_Sprite &sprite, uint8_t col, uint8_t row) {
+    uint16_t changed = 0;
+    uint16_t count = (uint16_t)sprite.width * sprite.height;
+    for (uint16_t i = 0; i < count; i++) {
+      uint16_t x = sprite.col + i % sprite.width;
+      uint16_t y = sprite.row + i / sprite.width;
+      if (x > _width || y > _height || !_spriteOpaqueAt(sprite, x, y)) continue;
+      if (col && x >= col && y >= row && x < col + sprite.width && y < row + sprite.height) continue;
+      const AnsiCell &cell = sprite.saved[i];
+      changed += _storeCell(_buffer[_getIndex(x, y)], cell.character, cell.fgColor, cell.bgColor,
+                            cell.attributes);
+    }
+    return changed;
+  }
+
+  // --- Bound Data Field Helpers ---
+  int8_t _addField(uint8_t col, uint8_t row, uint8_t source, const qANSI_NumberFormat &format) {
+    if (!_buffer || col < 1 || col > _width || row < 1 || row > _height || format.width == 0) {
+      return -1;
+    }
+    if (!_fields) {
+      _fields = new qANSI_Field[QANSI_MAX_FIELDS];
+      if (!_fields) return -1;
+    }
+    if (_fieldCount >= QANSI_MAX_FIELDS) return -1;
+    
+    qANSI_Field &field = _fields[_fieldCount];
+    field.col = col;
+    field.row = row;
+    field.width = min(format.width, (uint8_t)(_width - col + 1));  // Clip to terminal
+    field.source = source;
+    field.kind = _sourceKind(source);
+    field.fg = getCurrentFgColor();
+    field.bg = getCurrentBgColor();
+    field.attr = getCurrentAttribute();
+    field.valid = false;
+    field.format = format;
+    field.format.width = field.width;
+    memset(&field.value, 0, sizeof(field.value));
+    
+    return _fieldCount++;
+  }
+
+  // How a value read from source is formatted (SET fields start out SIGNED)
+  static uint8_t _sourceKind(uint8_t source) {
+    return (source == qANSI_Field::UINT || source == qANSI_Field::ULONG) ? qANSI_Field::UNSIGNED :
+           (source == qANSI_Field::FLOAT || source == qANSI_Field::DOUBLE ||
+            source == qANSI_Field::DOUBLE_FUNCTION) ? qANSI_Field::REAL : qANSI_Field::SIGNED;
+  }
+
+  qANSI_FieldValue _readField(const qANSI_Field &field) const {
+    qANSI_FieldValue value;
+    memset(&value, 0, sizeof(value));
+    switch (field.source) {
+      case qANSI_Field::INT:             value.l = *field.from.i; break;
+      case qANSI_Field::UINT:            value.ul = *field.from.ui; break;
+      case qANSI_Field::LONG:            value.l = *field.from.l; break;
+      case qANSI_Field::ULONG:           value.ul = *field.from.ul; break;
+      case qANSI_Field::FLOAT:           value.d = *field.from.f; break;
+      case qANSI_Field::DOUBLE:          value.d = *field.from.d; break;
+      case qANSI_Field::LONG_FUNCTION:   value.l = field.from.lf(); break;
+      case qANSI_Field::DOUBLE_FUNCTION: value.d = field.from.df(); break;
+      default:                           value = field.value; break;  // SET
+    }
+    return value;
+  }
+
+  bool _setField(uint8_t id, uint8_t kind, const qANSI_FieldValue &value) {
+    if (id >= _fieldCount) return false;
+    qANSI_Field &field = _fields[id];
+    if (field.valid && field.kind == kind && memcmp(&value, &field.value, sizeof(value)) == 0) {
+      return false;
+    }
+    field.kind = kind;
+    field.value = value;
+    _drawField(field);
+    return true;
+  }
+
+  // Format the value and store it, marking only the cells that change
+  void _drawField(qANSI_Field &field) {
+    char text[qANSI_Format::BUFFER_SIZE];
+    uint8_t length;
+    if (field.kind == qANSI_Field::REAL) {
+      length = qANSI_Format::formatFloat(text, field.value.d, field.format);
+    } else if (field.kind == qANSI_Field::UNSIGNED) {
+      length = qANSI_Format::formatUnsigned(text, field.value.ul, field.format);
+    } else {
+      length = qANSI_Format::formatSigned(text, field.value.l, field.format);
+    }
+    bool fits = length <= field.width;
+    
+    AnsiCell *cell = &_buffer[_getIndex(field.col, field.row)];
+    for (uint8_t i = 0; i < field.width; i++) {
+      _storeCell(cell[i], fits ? text[i] : '*', field.fg, field.bg, field.attr);
+    }
+    field.valid = true;
+  }
+
+  // --- Sink Helpers ---
+  size_t _pendingSize() const {
+    return ((size_t)_width * _height + 7) / 8;
+  }
+
+  // Mark every cell as not sent (bits past the last cell stay clear)
+  void _markPending(uint8_t *pending) {
+    size_t cells = (size_t)_width * _height;
+    memset(pending, 0xFF, cells / 8);
+    if (cells % 8) pending[cells / 8] = (1 << (cells % 8)) - 1;
+  }
+
+  // A cursor that was shown, hidden or moved is sent even without changes
+  bool _sinkCursorChanged(const qANSI_Sink &sink) const {
+    uint8_t col = isCursorVisible() ? _posX + _cursorX - 1 : 0;
+    uint8_t row = isCursorVisible() ? _posY + _cursorY - 1 : 0;
+    return sink.cursorCol != col || sink.cursorRow != row;
+  }
+
+  // Mark every cell of a state sync snapshot as unknown (no stored cell has
+  // color 0, so none compares equal)
+  void _forgetCells(AnsiCell *cells) {
+    memset(cells, 0, (size_t)_width * _height * sizeof(AnsiCell));
+  }
+
+  // Compare a snapshot with the buffer. Sets the bits of the cells that
+  // differ in pending (if given) and returns true if any does.
+  bool _diffCells(const AnsiCell *snapshot, uint8_t *pending) const {
+    _resolveRows();
+    size_t cells = (size_t)_width * _height;
+    bool differs = false;
+    for (size_t i = 0; i < cells; i += 8) {
+      uint8_t bits = 0;
+      for (uint8_t b = 0; b < 8 && i + b < cells; b++) {
+        if (!_sameCell(snapshot[i + b], _buffer[i + b])) bits |= 1 << b;
+      }
+      if (bits && !pending) return true;
+      if (pending) pending[i / 8] = bits;
+      differs |= bits != 0;
+    }
+    return differs;
+  }
+
+  // Add the cells changed since the last display() call to every plain
+  // sink's bitmap, before the own output clears the dirty flags. State sync
+  // sinks compare with their snapshot instead. A position change resends
+  // everything.
+  void _collectSinkChanges() {
+    if (_forceFullRedraw) {
+      for (uint8_t i = 0; i < _sinkCount; i++) {
+        qANSI_Sink &sink = _sinks[i];
+        if (sink.acked) {
+          // The frame in flight is acknowledged as unknown cells as well
+          _forgetCells(sink.acked);
+          _forgetCells(sink.sent);
+        } else {
+          _markPending(sink.pending);
+        }
+      }
+      return;
+    }
+    _resolveRows();
+    size_t cells = (size_t)_width * _height;
+    for (size_t i = 0; i < cells; i += 8) {
+      uint8_t bits = 0;
+      for (uint8_t b = 0; b < 8 && i + b < cells; b++) {
+        if (_buffer[i + b].dirty) bits |= 1 << b;
+      }
+      if (!bits) continue;
+      for (uint8_t s = 0; s < _sinkCount; s++) {
+        if (!_sinks[s].acked) _sinks[s].pending[i / 8] |= bits;
+      }
+    }
+  }
+
+  // Send every sink its pending cells. The renderer's output state is
+  // switched to the sink, the own output's byte count and statistics are
+  // left as they were.
+  void _displaySinks() {
+    uint32_t ownBytes = _budgetBytes;
+    uint8_t ownModes = _runModes;
+#if QANSI_ENABLE_STATS
+    qANSI_FrameStats ownStats = _frameStats;
+#endif
+    uint8_t cursorCol = isCursorVisible() ? _posX + _cursorX - 1 : 0;
+    uint8_t cursorRow = isCursorVisible() ? _posY + _cursorY - 1 : 0;
+    for (uint8_t i = 0; i < _sinkCount; i++) {
+      qANSI_Sink &sink = _sinks[i];
+      sink.bytes = 0;
+      // One frame in flight at a time to a state sync sink, then the
+      // changes since the acknowledged screen
+      if (sink.inFlight) continue;
+      bool pending = sink.acked ? _diffCells(sink.acked, sink.pending) : isSinkPending(i);
+      if (!pending && !_sinkCursorChanged(sink)) continue;
+      _target = sink.stream;
+      _sinkPending = sink.pending;
+      _runModes = sink.runModes;
+      if (sink.acked) {
+        memcpy(sink.sent, sink.acked, (size_t)_width * _height * sizeof(AnsiCell));
+        _sinkSent = sink.sent;
+      }
+      _beginBudget(sink.budget);
+      if (_beginOutput()) {
+        for (uint8_t y = 1; y <= _height && !_drawRow(y, 1, false); y++) {}
+        _endOutput();
+        sink.cursorCol = cursorCol;
+        sink.cursorRow = cursorRow;
+        if (sink.acked) {
+          sink.frame++;
+          sink.inFlight = true;
+        }
+      }
+      sink.bytes = _budgetBytes;
+      _sinkSent = nullptr;
+      if (sink.inFlight && sink.hook) sink.hook(i, sink.frame, sink.context);
+    }
+    _target = &_output;
+    _sinkPending = nullptr;
+    _runModes = ownModes;
+    _budgetBytes = ownBytes;
+#if QANSI_ENABLE_STATS
+    _frameStats = ownStats;
+#endif
+    invalidateTerminalState();
+  }
+
+  // --- Snapshot Helpers ---
+  // Header: 'q' 'V' version width height posX posY cursorX cursorY flags fg bg
+  // attr. Then the cells, each a character (SNAPSHOT_LITERAL first if it is
+  // below SNAPSHOT_TOKENS), optionally followed by SNAPSHOT_REPEAT and the
+  // number of further copies; SNAPSHOT_STYLE fg bg attr sets the style of
+  // the cells that follow.
+  enum {
+    SNAPSHOT_VERSION = 1, SNAPSHOT_HEADER = 13,
+    SNAPSHOT_STYLE = 1, SNAPSHOT_REPEAT = 2, SNAPSHOT_LITERAL = 3, SNAPSHOT_TOKENS = 4
+  };
+  enum { SNAPSHOT_CURSOR_VISIBLE = 1, SNAPSHOT_LINE_WRAPPING = 2, SNAPSHOT_SCROLLING = 4 };
+  
+  static void _putSnapshotByte(uint8_t *data, size_t size, size_t &used, uint8_t value) {
+    if (data && used < size) data[used] = value;
+    used++;
+  }
+  
+  // Read the next cell and its repeat count at pos; cell keeps the style
+  // between calls. Returns false if the data is cut short or malformed.
+  static bool _readSnapshotCells(const uint8_t *data, size_t size, size_t &pos, AnsiCell &cell, uint8_t &count) {
+    count = 0;
+    if (pos < size && data[pos] == SNAPSHOT_STYLE) {
+      if (pos + 4 > size) return false;
+      cell.fgColor = data[pos + 1];
+      cell.bgColor = data[pos + 2];
+      cell.attributes = data[pos + 3];
+      pos += 4;
+    }
+    if (pos < size && data[pos] == SNAPSHOT_LITERAL) pos++;
+    else if (pos < size && data[pos] < SNAPSHOT_TOKENS) return false;
+    if (pos >= size) return false;
+    cell.character = data[pos++];
+    count = 1;
+    if (pos < size && data[pos] == SNAPSHOT_REPEAT) {
+      if (pos + 2 > size || data[pos + 1] == 0) return false;
+      count += data[pos + 1];
+      pos += 2;
+    }
+    return true;
+  }
+  
+  // Absolute cursor position in the shortest form, returns the bytes written
+  static size_t _printCursor(Print &out, uint8_t col, uint8_t row) {
+    char buf[12];
+    if (col == 1) sprintf(buf, "\033[%dH", row);
+    else sprintf(buf, "\033[%d;%dH", row, col);
+    return out.print(buf);
+  }
+
+  // --- Budget Helpers ---
+  void _beginBudget(const qANSI_Budget &budget) {
+    _budgetBytes = 0;
+    _budgetLimit = budget.maxBytes ? budget.maxBytes : 0xFFFFFFFFUL;
+    if (budget.useTxBuffer) {
+      int room = _target->availableForWrite();
+      if (room < 0) room = 0;
+      if ((uint32_t)room < _budgetLimit) _budgetLimit = room;
+    }
+    _budgetReserve = _epilogueCost();
+    _budgetMicros = budget.maxMicros;
+    _budgetStart = micros();
+  }
+
+  // True if `cost` more bytes can be sent without touching the epilogue
+  // reserve and the deadline has not passed
+  bool _budgetAllows(uint16_t cost) const {
+    if ((uint32_t)cost + _budgetReserve > _budgetLimit - _budgetBytes) return false;
+    if (_budgetMicros && (uint32_t)(micros() - _budgetStart) >= _budgetMicros) return false;
+    return true;
+  }
+
+  static uint8_t _digitCount(uint8_t v) {
+    return v >= 100 ? 3 : (v >= 10 ? 2 : 1);
+  }
+
+  // Length of "\033[row;colH"
+  static uint8_t _cursorCost(uint8_t col, uint8_t row) {
+    return 4 + _digitCount(col) + _digitCount(row);
+  }
+
+  // Length of "\033[codem"
+  static uint8_t _sgrCost(uint8_t code) {
+    return 3 + _digitCount(code);
+  }
+
+  uint8_t _epilogueCost() const {
+    return isCursorVisible() ? _cursorCost(_posX + _cursorX - 1, _posY + _cursorY - 1) + 6 : 6;
+  }
+
+  // Bytes needed to send a cell, including style changes but not positioning
+  uint8_t _cellCost(uint16_t index) const {
+    const AnsiCell &cell = _buffer[index];
+    uint8_t cost = 1;
+    uint8_t fg = _terminalFg;
+    uint8_t bg = _terminalBg;
+    if (cell.attributes != _terminalAttr) {
+      if (_terminalAttr != qANSI_Attributes::RESET) {
+        cost += _sgrCost(qANSI_Attributes::RESET);
+        fg = qANSI_Colors::FG_DEFAULT;
+        bg = qANSI_Colors::BG_DEFAULT;
+      }
+      if (cell.attributes != qANSI_Attributes::RESET) cost += _sgrCost(cell.attributes);
+    }
+    if (cell.fgColor != fg) cost += _sgrCost(cell.fgColor);
+    if (cell.bgColor != bg) cost += _sgrCost(cell.bgColor);
+    return cost;
+  }
+
+  bool _hasDirtyCells() const {
+    if (_hasStaleRows()) return true;
+    size_t bufferSize = (size_t)_width * _height;
+    for (size_t i = 0; i < bufferSize; i++) {
+      if (_buffer[i].dirty) return true;
+    }
+    return false;
+  }
+
+  bool _rowHasDirty(uint8_t y) const {
+    const AnsiCell *cell = &_buffer[_getIndex(1, y)];
+    for (uint8_t x = 0; x < _width; x++) {
+      if (cell[x].dirty) return true;
+    }
+    return false;
+  }
+
+  // Send one buffer cell, moving the physical cursor first if needed.
+  // Returns false without sending anything if the budget is exhausted.
+  bool _drawCell(uint8_t x, uint8_t y) {
+    uint8_t col = _posX + x - 1;
+    uint8_t row = _posY + y - 1;
+    uint16_t index = _getIndex(x, y);
+    bool move = (_terminalCursorX != col || _terminalCursorY != row);
+    
+    if (!_budgetAllows(_cellCost(index) + (move ? _cursorCost(col, row) : 0))) {
+      return false;
+    }
+    
+    if (move) _emitCursor(col, row);
+    _updateCellAppearance(index);
+    _emitChar(_buffer[index].character);
+    QANSI_STAT(_frameStats.cellsEmitted++);
+    _terminalCursorX++;
+    _markSent(index);
+    return true;
+  }
+
+  // True if display() has to send the cell: it changed, or the row strategy
+  // resends it and no priority region has sent it already
+  bool _needsDraw(uint8_t x, uint8_t y, bool wholeRow) const {
+    uint16_t index = _getIndex(x, y);
+    if (_sinkPending) return _sinkPending[index >> 3] & (1 << (index & 7));
+    return _buffer[index].dirty || (wholeRow && !_inRegion(x, y));
+  }
+
+  // The cell went out to the stream being drawn
+  void _markSent(uint16_t index) {
+    if (_sinkPending) {
+      _sinkPending[index >> 3] &= ~(1 << (index & 7));
+      if (_sinkSent) _sinkSent[index] = _buffer[index];
+    } else {
+      _buffer[index].dirty = false;
+      if (_front) _front[index] = _buffer[index];
+    }
+  }
+
+  // Send the cells of row y that need it, from column x on. Returns 0 when
+  // the row is done, or the column where the budget ran out.
+  uint8_t _drawRow(uint8_t y, uint8_t x, bool wholeRow) {
+    for (; x <= _width; x++) {
+      if (!_needsDraw(x, y, wholeRow)) continue;
+      // Runs start where a cell equals the next one, other cells go
+      // straight out
+      uint16_t index = _getIndex(x, y);
+      bool run = (_runModes & _runMode(_buffer[index])) && x < _width &&
+                 _sameCell(_buffer[index], _buffer[index + 1]);
+      uint8_t sent = run ? _drawRun(x, y, wholeRow) : (_drawCell(x, y) ? 1 : 0);
+      if (!sent) return x;
+      x += sent - 1;
+    }
+    return 0;
+  }
+
+  // Hide the cursor and reset the attributes, the physical state is unknown
+  // at the start of every call. Returns false if the prologue and epilogue
+  // do not fit in the budget.
+  bool _beginOutput() {
+    uint16_t prologue = (isCursorVisible() ? 0 : 6) + 4;
+    if (!_budgetAllows(prologue)) return false;
+    
+    // Hide cursor during updates
+    if (!isCursorVisible()) {
+      _emitRaw("\033[?25l");
+    }
+    
+    // Initialize drawing state
+    _emitRaw("\033[0m", qANSI_FrameStats::SGR);
+    _terminalAttr = qANSI_Attributes::RESET;
+    _terminalFg = qANSI_Colors::FG_DEFAULT;
+    _terminalBg = qANSI_Colors::BG_DEFAULT;
+    _terminalCursorX = 0;
+    _terminalCursorY = 0;
+    return true;
+  }
+
+  // Position cursor or hide it as needed
+  void _endOutput() {
+    if (isCursorVisible()) {
+      _emitCursor(_posX + _cursorX - 1, _posY + _cursorY - 1);
+      _emitRaw("\033[?25h"); // Show cursor
+    } else {
+      _emitRaw("\033[?25l"); // Hide cursor
+    }
+  }
+
+  static bool _sameCell(const AnsiCell &a, const AnsiCell &b) {
+    return a.character == b.character && a.fgColor == b.fgColor &&
+           a.bgColor == b.bgColor && a.attributes == b.attributes;
+  }
+
+  // Length of the run of identical cells starting at x that is shorter to
+  // send as one erase or repeat sequence than cell by cell, 1 if none is
+  uint8_t _runLength(uint8_t x, uint8_t y, bool wholeRow) const {
+    uint16_t index = _getIndex(x, y);
+    const AnsiCell &first = _buffer[index];
+    if (!(_runModes & _runMode(first))) return 1;
+    
+    uint8_t n = 1;
+    while (x + n <= _width && _needsDraw(x + n, y, wholeRow) && _sameCell(first, _buffer[index + n])) n++;
+    if (n < 4) return 1;
+    
+    // ECH leaves the cursor at the start of the run, so a cell drawn right
+    // after the run needs a cursor move
+    uint8_t cost = _runCost(index, n);
+    if (_runMode(first) == RUN_ERASE && x + n <= _width && _needsDraw(x + n, y, wholeRow)) {
+      cost += _cursorCost(_posX + x + n - 1, _posY + y - 1);
+    }
+    return cost < n ? n : 1;
+  }
+
+  // Blanks with the default background are erased (ECH), since an erased
+  // cell shows the default background without bce; anything else is
+  // repeated (REP)
+  static uint8_t _runMode(const AnsiCell &cell) {
+    return cell.character == ' ' && cell.attributes == qANSI_Attributes::RESET &&
+           cell.bgColor == qANSI_Colors::BG_DEFAULT ? RUN_ERASE : RUN_REPEAT;
+  }
+
+  // Bytes of the erase sequence, or of the character and repeat sequence
+  uint8_t _runCost(uint16_t index, uint8_t n) const {
+    return _runMode(_buffer[index]) == RUN_ERASE ? 3 + _digitCount(n) : 4 + _digitCount(n - 1);
+  }
+
+  // Send the cell at x, or the run of identical cells starting there as one
+  // sequence (see _runLength()). Returns the number of cells sent, 0 if the
+  // budget is exhausted.
+  uint8_t _drawRun(uint8_t x, uint8_t y, bool wholeRow) {
+    uint8_t n = _runLength(x, y, wholeRow);
+    uint8_t col = _posX + x - 1;
+    uint8_t row = _posY + y - 1;
+    uint16_t index = _getIndex(x, y);
+    bool move = (_terminalCursorX != col || _terminalCursorY != row);
+    if (n == 1 ||
+        !_budgetAllows(_cellCost(index) - 1 + _runCost(index, n) + (move ? _cursorCost(col, row) : 0))) {
+      return _drawCell(x, y) ? 1 : 0;
+    }
+    
+    if (move) _emitCursor(col, row);
+    _updateCellAppearance(index);
+    char buf[8];
+    if (_runMode(_buffer[index]) == RUN_ERASE) {
+      sprintf(buf, "\033[%dX", n);
+      _emitRaw(buf, qANSI_FrameStats::ERASE);
+    } else {
+      _emitChar(_buffer[index].character);
+      sprintf(buf, "\033[%db", n - 1);
+      _emitRaw(buf, qANSI_FrameStats::TEXT);
+      _terminalCursorX += n;
+    }
+    for (uint8_t i = 0; i < n; i++) _markSent(index + i);
+    QANSI_STAT(_frameStats.cellsEmitted += n);
+    return n;
+  }
+
+  // --- Output Helpers (count bytes against the budget) ---
+  // Send one escape sequence
+  void _emitRaw(const char *command, uint8_t category = qANSI_FrameStats::CONTROL) {
+    size_t n = _target->print(command);
+    _budgetBytes += n;
+    QANSI_STAT(_frameStats.bytes[category] += n);
+    QANSI_STAT(_frameStats.escapes++);
+    (void)category;
+  }
+
+  void _emitChar(char c) {
+    size_t n = _target->write((uint8_t)c);
+    _budgetBytes += n;
+    QANSI_STAT(_frameStats.bytes[qANSI_FrameStats::TEXT] += n);
+  }
+
+  // Send an SGR code without touching the drawing style (_currentFg etc.)
+  void _emitSgr(uint8_t code) {
+    char buf[8];
+    sprintf(buf, "\033[%dm", code);
+    _emitRaw(buf, qANSI_FrameStats::SGR);
+  }
+
+  void _emitCursor(uint8_t col, uint8_t row) {
+    char buf[12];
+    sprintf(buf, "\033[%d;%dH", row, col);
+    _emitRaw(buf, qANSI_FrameStats::CURSOR);
+    _terminalCursorX = col;
+    _terminalCursorY = row;
+  }
 };
 
 #endif // Q_ANSI_VT_H